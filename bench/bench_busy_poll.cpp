@@ -0,0 +1,71 @@
+// 对比 io_context::run() 与 run_busy_poll() 的唤醒延迟和 CPU 占用
+#include <time.h>
+
+#include <algorithm>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+#include "runtime.h"
+
+using namespace cpphttp;
+namespace asio = boost::asio;
+
+namespace {
+
+constexpr size_t kEvents = 20000;
+constexpr auto kInterval = std::chrono::microseconds(20);
+
+double thread_cpu_seconds() {
+  timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <typename Runner>
+void measure(const char *name, Runner &&runner) {
+  asio::io_context ctx(1);
+  auto guard = asio::make_work_guard(ctx);
+  std::vector<int64_t> latencies;
+  latencies.reserve(kEvents);
+  double cpu = 0;
+
+  std::thread consumer([&]() {
+    auto start = thread_cpu_seconds();
+    runner(ctx);
+    cpu = thread_cpu_seconds() - start;
+  });
+
+  auto wall_start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < kEvents; i++) {
+    auto due = std::chrono::steady_clock::now() + kInterval;
+    while (std::chrono::steady_clock::now() < due) {
+    }
+    auto posted = std::chrono::steady_clock::now();
+    asio::post(ctx, [&latencies, posted]() {
+      latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - posted).count());
+    });
+  }
+  guard.reset();
+  consumer.join();
+  std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wall_start;
+
+  std::sort(latencies.begin(), latencies.end());
+  auto pct = [&](double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))]; };
+  fmt::print("{:<10} p50 {:>7} ns  p99 {:>7} ns  p99.9 {:>7} ns  max {:>8} ns  cpu {:>5.1f}%\n", name, pct(0.5), pct(0.99),
+             pct(0.999), latencies.back(), cpu / wall.count() * 100);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int cpu = argc > 1 ? std::atoi(argv[1]) : -1;
+  measure("run", [](asio::io_context &ctx) { ctx.run(); });
+  measure("busy_poll", [cpu](asio::io_context &ctx) { run_busy_poll(ctx, cpu); });
+  return 0;
+}
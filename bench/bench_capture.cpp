@@ -0,0 +1,39 @@
+// 抓包写入开销和全速回放吞吐
+#include <chrono>
+#include <fmt/format.h>
+#include <string>
+
+#include "capture.h"
+
+using namespace cpphttp;
+
+int main() {
+  const std::string path = "/tmp/cpphttp_bench_capture.bin";
+  const size_t count = 5'000'000;
+  const std::string payload(200, 'x');
+
+  auto start = std::chrono::steady_clock::now();
+  {
+    CaptureWriter writer(path, 256 * 1024 * 1024);
+    auto id = writer.next_connection_id();
+    for (size_t i = 0; i < count; i++) {
+      writer.append(CaptureKind::websocket, id, static_cast<int64_t>(i), payload);
+    }
+  }
+  std::chrono::duration<double> write_elapsed = std::chrono::steady_clock::now() - start;
+
+  CaptureReader reader(path);
+  CaptureRecord record;
+  size_t bytes = 0;
+  start = std::chrono::steady_clock::now();
+  while (reader.next(record, CaptureKind::websocket)) {
+    bytes += record.payload.size();
+  }
+  std::chrono::duration<double> read_elapsed = std::chrono::steady_clock::now() - start;
+
+  fmt::print("append  {:>8.1f} ns/msg  {:>6.2f} M msg/s\n", write_elapsed.count() * 1e9 / count,
+             count / write_elapsed.count() / 1e6);
+  fmt::print("replay  {:>8.1f} ns/msg  {:>6.2f} M msg/s  ({} bytes)\n", read_elapsed.count() * 1e9 / count,
+             count / read_elapsed.count() / 1e6, bytes);
+  return 0;
+}
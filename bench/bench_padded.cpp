@@ -0,0 +1,74 @@
+// 对比当前接收路径（flat_buffer -> std::string -> 带填充的副本）与直接读入 PaddedBuffer
+#include <boost/beast/core/flat_buffer.hpp>
+#include <chrono>
+#include <cstring>
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "padded_buffer.h"
+
+using namespace cpphttp;
+
+namespace {
+
+constexpr size_t kChunk = 4096;
+
+// 模拟 socket 按块把消息写入 DynamicBuffer
+template <typename DynamicBuffer>
+void fill(DynamicBuffer &buffer, const std::string &payload) {
+  for (size_t offset = 0; offset < payload.size(); offset += kChunk) {
+    auto n = std::min(kChunk, payload.size() - offset);
+    auto mb = buffer.prepare(n);
+    std::memcpy(mb.data(), payload.data() + offset, n);
+    buffer.commit(n);
+  }
+}
+
+// 与 simdjson::padded_string 构造时的行为一致：分配 size + padding 并拷贝
+std::unique_ptr<char[]> pad_copy(const std::string &str) {
+  auto padded = std::make_unique_for_overwrite<char[]>(str.size() + PaddedBuffer::kPadding);
+  std::memcpy(padded.get(), str.data(), str.size());
+  std::memset(padded.get() + str.size(), 0, PaddedBuffer::kPadding);
+  return padded;
+}
+
+template <typename F>
+double run(size_t iterations, F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+}  // namespace
+
+int main() {
+  size_t checksum = 0;
+  for (size_t size : std::vector<size_t>{256, 4096, 65536, 1 << 20}) {
+    std::string payload(size, 'x');
+    size_t iterations = std::max<size_t>(1000, (256u << 20) / size);
+
+    auto copy_ns = run(iterations, [&]() {
+      boost::beast::flat_buffer buffer;
+      fill(buffer, payload);
+      std::string str((char *)buffer.data().data(), buffer.data().size());
+      auto padded = pad_copy(str);
+      checksum += padded[size / 2];
+    });
+
+    auto padded_ns = run(iterations, [&]() {
+      PaddedBuffer buffer;
+      fill(buffer, payload);
+      checksum += buffer.bytes()[size / 2];
+    });
+
+    fmt::print("{:>8} bytes  copy path {:>10.1f} ns ({:>7.2f} GB/s)  padded path {:>10.1f} ns ({:>7.2f} GB/s)\n", size,
+               copy_ns, size / copy_ns, padded_ns, size / padded_ns);
+  }
+  fmt::print("checksum {}\n", checksum);
+  return 0;
+}
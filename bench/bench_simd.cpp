@@ -0,0 +1,51 @@
+// UTF-8 校验：标量实现与运行时选择的 SIMD 实现对比
+#include <chrono>
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+#include "simd.h"
+
+using namespace cpphttp;
+
+namespace {
+
+template <typename F>
+double gbps(size_t bytes, F &&f) {
+  size_t iterations = std::max<size_t>(100, (512u << 20) / bytes);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < iterations; i++) {
+    f();
+  }
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return bytes * iterations / elapsed.count();
+}
+
+std::string json_payload(size_t size, bool with_unicode) {
+  std::string unit = with_unicode ? R"({"s":"BTCUSDT","p":"67012.10","q":"0.004","n":"比特币"},)"
+                                  : R"({"s":"BTCUSDT","p":"67012.10","q":"0.004","t":1718000000123},)";
+  std::string payload;
+  while (payload.size() + unit.size() <= size) {
+    payload += unit;
+  }
+  return payload;
+}
+
+}  // namespace
+
+int main() {
+  fmt::print("backend: {}\n", simd_backend());
+
+  size_t checksum = 0;
+  for (bool unicode : {false, true}) {
+    for (size_t size : std::vector<size_t>{1024, 16384, 1 << 20}) {
+      auto payload = json_payload(size, unicode);
+      auto scalar_rate = gbps(payload.size(), [&]() { checksum += scalar::validate_utf8(payload.data(), payload.size()); });
+      auto simd_rate = gbps(payload.size(), [&]() { checksum += validate_utf8(payload.data(), payload.size()); });
+      fmt::print("utf8 {:<7} {:>8} bytes  scalar {:>7.2f} GB/s  simd {:>7.2f} GB/s\n", unicode ? "mixed" : "ascii",
+                 payload.size(), scalar_rate, simd_rate);
+    }
+  }
+  fmt::print("checksum {}\n", checksum);
+  return 0;
+}
@@ -10,6 +10,13 @@
 #include <memory>
 #include <string>
 
+#include "capture.h"
+#include "connect.h"
+#include "endpoint_group.h"
+#include "padded_buffer.h"
+#include "shm_ring.h"
+#include "timestamp_socket.h"
+
 namespace cpphttp {
 
 namespace asio = boost::asio;
@@ -18,22 +25,66 @@ using tcp = asio::ip::tcp;
 
 class WebSocketDetailInterface;
 
+// 收到消息时的 UTF-8 校验范围
+enum class Utf8Validation {
+  // 只校验文本帧（RFC 6455 8.1），由 Beast 在读取时完成
+  text,
+  // 二进制帧和回放的消息再用 SIMD 的 validate_utf8 额外校验一遍，适合用二进制帧发送 JSON 的行情源
+  // 这是在 Beast 之外多出的一趟扫描，不会加快文本帧的校验
+  all,
+};
+
 class WebSocket {
  public:
   WebSocket();
   WebSocket(const std::string &uri);
   int add_uri(const std::string &uri);
+  // 收到的每条消息连同接收时间戳写入共享内存环，供其他进程读取
+  // 超过环容量一半的消息不会写入，由 ShmRingWriter::dropped() 计数，读者通过 seq 的间隔发现
+  int set_publisher(std::shared_ptr<ShmRingWriter> publisher);
+  // 把收到的每条消息追加到抓包文件
+  int set_capture(std::shared_ptr<CaptureWriter> capture);
+  // connect() 不再建立网络连接，read() 按顺序回放抓包文件中的消息
+  // 使用自己的读位置，同一个 replay 可以同时交给其他 WebSocket 和 HttpRequest
+  // original_speed 为 true 时按录制时的时间间隔回放，否则全速回放
+  int set_replay(std::shared_ptr<CaptureReader> replay, uint32_t connection_id = CaptureReader::kAnyConnection,
+                 bool original_speed = false);
+  // 在 connect() 之前调用，开启 SO_TIMESTAMPING，read_timestamped() 返回内核接收时间
+  int set_rx_timestamping(bool enable);
+  // 在 connect() 之前调用
+  int set_socket_options(const SocketOptions &options);
+  // 在 connect() 之前调用，每次 connect() 连接 group 中当前最好的端点，URI 只提供路径
+  int set_endpoint_group(std::shared_ptr<EndpointGroup> group);
+  // 校验失败时 read() 抛出 websocket::error::bad_frame_payload，连接保持打开
+  int set_utf8_validation(Utf8Validation mode);
   asio::awaitable<void> connect();
   asio::awaitable<std::string> read();
+  // 消息直接读入带 SIMD 填充的缓冲区，可以零拷贝交给 simdjson
+  asio::awaitable<PaddedBuffer> read_padded();
+  asio::awaitable<TimestampedMessage> read_timestamped();
   asio::awaitable<void> write(const std::string &msg);
   asio::awaitable<void> close();
 
  private:
-  bool m_is_ssl;
+  bool m_is_ssl = false;
   std::string m_host;
   int m_port;
   std::string m_path;
   std::unique_ptr<WebSocketDetailInterface> m_ws_detail;
+  std::shared_ptr<ShmRingWriter> m_publisher;
+  std::shared_ptr<CaptureWriter> m_capture;
+  uint32_t m_capture_id = 0;
+  // 重新 connect() 时从上次的位置继续回放
+  std::shared_ptr<CaptureCursor> m_replay;
+  uint32_t m_replay_connection = CaptureReader::kAnyConnection;
+  bool m_replay_original_speed = false;
+  bool m_rx_timestamping = false;
+  SocketOptions m_socket_options;
+  std::shared_ptr<EndpointGroup> m_group;
+  Utf8Validation m_utf8_validation = Utf8Validation::text;
+
+  void validate(std::string_view msg) const;
+  void on_message(std::string_view msg, std::chrono::system_clock::time_point received);
 };
 
 class WebSocketDetailInterface {
@@ -41,43 +92,103 @@ class WebSocketDetailInterface {
     virtual ~WebSocketDetailInterface() {}
     virtual asio::awaitable<void> connect() = 0;
     virtual asio::awaitable<std::string> read() = 0;
+    virtual asio::awaitable<PaddedBuffer> read_padded() = 0;
+    virtual asio::awaitable<TimestampedMessage> read_timestamped() = 0;
     virtual asio::awaitable<void> write(const std::string &msg) = 0;
     virtual asio::awaitable<void> close() = 0;
+    // 最近读到的消息是否是文本帧，文本帧已经由 Beast 校验过 UTF-8
+    virtual bool got_text() const = 0;
 };
 
 template <typename WsSocketType>
 class WebSocketDetail : public WebSocketDetailInterface {
  public:
-  WebSocketDetail(const std::string &host, int port, const std::string &path)
-      : m_host(host), m_port(port), m_path(path){};
+  WebSocketDetail(const std::string &host, int port, const std::string &path, const SocketOptions &options = {},
+                  std::shared_ptr<EndpointGroup> group = nullptr)
+      : m_host(host), m_port(port), m_path(path), m_socket_options(options), m_group(std::move(group)){};
   ~WebSocketDetail() {}
 
   virtual asio::awaitable<void> connect() { co_return; }
 
   asio::awaitable<std::string> read();
+  asio::awaitable<PaddedBuffer> read_padded();
+  asio::awaitable<TimestampedMessage> read_timestamped();
   asio::awaitable<void> write(const std::string &msg);
   asio::awaitable<void> close();
+  bool got_text() const { return m_ws->got_text(); }
 
  protected:
+  virtual TimestampSocket *timestamp_socket() { return nullptr; }
+
   const std::string m_host;
   const int m_port;
   const std::string m_path;
+  const SocketOptions m_socket_options;
+  const std::shared_ptr<EndpointGroup> m_group;
 
   std::unique_ptr<WsSocketType> m_ws;
 };
 
 class WebSocketDetailWS : public WebSocketDetail<beast::websocket::stream<asio::ip::tcp::socket>> {
  public:
-  WebSocketDetailWS(const std::string &host, int port, const std::string &path)
-      : WebSocketDetail<beast::websocket::stream<asio::ip::tcp::socket>>(host, port, path){};
+  WebSocketDetailWS(const std::string &host, int port, const std::string &path, const SocketOptions &options = {},
+                    std::shared_ptr<EndpointGroup> group = nullptr)
+      : WebSocketDetail<beast::websocket::stream<asio::ip::tcp::socket>>(host, port, path, options, std::move(group)){};
   asio::awaitable<void> connect() override;
 };
 
 class WebSocketDetailWSS : public WebSocketDetail<beast::websocket::stream<asio::ssl::stream<asio::ip::tcp::socket>>> {
  public:
-  WebSocketDetailWSS(const std::string &host, int port, const std::string &path)
-      : WebSocketDetail<beast::websocket::stream<asio::ssl::stream<asio::ip::tcp::socket>>>(host, port, path){};
+  WebSocketDetailWSS(const std::string &host, int port, const std::string &path, const SocketOptions &options = {},
+                     std::shared_ptr<EndpointGroup> group = nullptr)
+      : WebSocketDetail<beast::websocket::stream<asio::ssl::stream<asio::ip::tcp::socket>>>(host, port, path, options, std::move(group)){};
+  asio::awaitable<void> connect() override;
+};
+
+class WebSocketDetailWSTimestamped : public WebSocketDetail<beast::websocket::stream<TimestampSocket>> {
+ public:
+  WebSocketDetailWSTimestamped(const std::string &host, int port, const std::string &path, const SocketOptions &options = {},
+                               std::shared_ptr<EndpointGroup> group = nullptr)
+      : WebSocketDetail<beast::websocket::stream<TimestampSocket>>(host, port, path, options, std::move(group)){};
+  asio::awaitable<void> connect() override;
+
+ protected:
+  TimestampSocket *timestamp_socket() override { return &m_ws->next_layer(); }
+};
+
+class WebSocketDetailWSSTimestamped : public WebSocketDetail<beast::websocket::stream<asio::ssl::stream<TimestampSocket>>> {
+ public:
+  WebSocketDetailWSSTimestamped(const std::string &host, int port, const std::string &path, const SocketOptions &options = {},
+                                std::shared_ptr<EndpointGroup> group = nullptr)
+      : WebSocketDetail<beast::websocket::stream<asio::ssl::stream<TimestampSocket>>>(host, port, path, options, std::move(group)){};
+  asio::awaitable<void> connect() override;
+
+ protected:
+  TimestampSocket *timestamp_socket() override { return &m_ws->next_layer().next_layer(); }
+};
+
+class WebSocketDetailReplay : public WebSocketDetailInterface {
+ public:
+  WebSocketDetailReplay(std::shared_ptr<CaptureCursor> reader, uint32_t connection_id, bool original_speed)
+      : m_reader(std::move(reader)), m_connection_id(connection_id), m_original_speed(original_speed){};
+
   asio::awaitable<void> connect() override;
+  asio::awaitable<std::string> read() override;
+  asio::awaitable<PaddedBuffer> read_padded() override;
+  asio::awaitable<TimestampedMessage> read_timestamped() override;
+  asio::awaitable<void> write(const std::string &msg) override;
+  asio::awaitable<void> close() override;
+  // 抓包文件不记录帧类型
+  bool got_text() const override { return false; }
+
+ private:
+  asio::awaitable<CaptureRecord> next();
+
+  std::shared_ptr<CaptureCursor> m_reader;
+  const uint32_t m_connection_id;
+  const bool m_original_speed;
+  int64_t m_first_timestamp = -1;
+  std::chrono::steady_clock::time_point m_start;
 };
 
 }  // namespace Common
@@ -0,0 +1,90 @@
+#ifndef __COMMON_CACHE_H__
+#define __COMMON_CACHE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace cpphttp {
+
+struct CacheEntry {
+  std::shared_ptr<const std::string> body;
+  std::string etag;
+  std::string last_modified;
+  std::chrono::steady_clock::time_point expires;
+  std::chrono::seconds max_age{0};
+  bool no_cache = false;
+
+  bool fresh(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const {
+    return !no_cache && now < expires;
+  }
+  bool has_validator() const { return !etag.empty() || !last_modified.empty(); }
+};
+
+struct CacheControl {
+  bool no_store = false;
+  bool no_cache = false;
+  std::optional<std::chrono::seconds> max_age;
+
+  static CacheControl parse(std::string_view value);
+};
+
+// 进程内按字节数限制大小的 LRU 响应缓存，可以被多个 HttpRequest 共享
+// 新鲜的条目直接返回，过期但带有 ETag/Last-Modified 的条目通过条件请求重新验证
+class ResponseCache {
+ public:
+  // ignored_headers 中的头部（不区分大小写）不参与 key 计算，例如每次都不同的请求 ID
+  explicit ResponseCache(size_t max_bytes = 16 * 1024 * 1024, std::vector<std::string> ignored_headers = {});
+
+  // key 包含方法、URL 和所有未忽略的请求头，携带不同凭证或 Accept 的请求不会互相命中
+  std::string make_key(const std::string &method, const std::string &url,
+                       const std::map<std::string, std::string> &headers) const;
+
+  // 命中新鲜条目时计为一次 hit
+  std::optional<CacheEntry> lookup(const std::string &key);
+  // 每次从网络下载完整响应体都计为一次 miss，是否缓存由 Cache-Control 决定
+  void store(const std::string &key, std::shared_ptr<const std::string> body, std::string_view cache_control,
+             std::string_view etag, std::string_view last_modified);
+  // 收到 304 后刷新有效期，计为一次 revalidation
+  void revalidated(const std::string &key, std::string_view cache_control);
+  void erase(const std::string &key);
+
+  size_t size_bytes() const;
+  size_t entries() const;
+  uint64_t hits() const { return m_hits; }
+  uint64_t misses() const { return m_misses; }
+  uint64_t revalidations() const { return m_revalidations; }
+
+ private:
+  struct Node {
+    CacheEntry entry;
+    std::list<std::string>::iterator lru;
+  };
+
+  void erase_locked(std::unordered_map<std::string, Node>::iterator iter);
+  static size_t cost(const std::string &key, const CacheEntry &entry);
+
+  const size_t m_max_bytes;
+  std::vector<std::string> m_ignored_headers;
+  mutable std::mutex m_mutex;
+  std::list<std::string> m_lru;
+  std::unordered_map<std::string, Node> m_entries;
+  size_t m_bytes = 0;
+
+  std::atomic<uint64_t> m_hits{0};
+  std::atomic<uint64_t> m_misses{0};
+  std::atomic<uint64_t> m_revalidations{0};
+};
+
+}  // namespace cpphttp
+
+#endif
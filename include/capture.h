@@ -0,0 +1,105 @@
+#ifndef __COMMON_CAPTURE_H__
+#define __COMMON_CAPTURE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace cpphttp {
+
+// 只追加的内存映射抓包文件
+// 文件头之后依次是 CaptureRecordHeader + payload，按 8 字节对齐，kind 为 0 表示结束
+
+enum class CaptureKind : uint8_t {
+  websocket = 1,
+  http = 2,
+};
+
+struct CaptureRecordHeader {
+  uint32_t size;
+  uint32_t connection_id;
+  uint8_t kind;
+  uint8_t reserved[7];
+  int64_t timestamp_ns;
+};
+
+struct CaptureRecord {
+  std::string_view payload;
+  uint32_t connection_id = 0;
+  CaptureKind kind = CaptureKind::websocket;
+  int64_t timestamp_ns = 0;
+};
+
+class CaptureWriter {
+ public:
+  explicit CaptureWriter(const std::string &path, size_t initial_size = 64 * 1024 * 1024);
+  ~CaptureWriter();
+  CaptureWriter(const CaptureWriter &) = delete;
+  CaptureWriter &operator=(const CaptureWriter &) = delete;
+
+  uint32_t next_connection_id() { return ++m_connection_ids; }
+  int append(CaptureKind kind, uint32_t connection_id, int64_t timestamp_ns, std::string_view payload);
+  // 截断到实际长度并落盘，之后不能再写
+  int close();
+
+  uint64_t records() const { return m_records; }
+
+ private:
+  void grow(size_t needed);
+
+  int m_fd = -1;
+  char *m_map = nullptr;
+  size_t m_mapped = 0;
+  size_t m_end = 0;
+  std::mutex m_mutex;
+  std::atomic<uint32_t> m_connection_ids{0};
+  uint64_t m_records = 0;
+};
+
+class CaptureReader {
+ public:
+  static constexpr uint32_t kAnyConnection = 0;
+
+  explicit CaptureReader(const std::string &path);
+  ~CaptureReader();
+  CaptureReader(const CaptureReader &) = delete;
+  CaptureReader &operator=(const CaptureReader &) = delete;
+
+  // 用 reader 自带的读位置返回下一条匹配的记录，payload 指向映射内存，在 reader 销毁前有效
+  // 跳过的其他记录不会再被返回；多个连接回放同一个文件时应各自使用 CaptureCursor
+  bool next(CaptureRecord &record, CaptureKind kind, uint32_t connection_id = kAnyConnection);
+  void rewind();
+
+  // 从 pos 开始查找下一条匹配的记录并前移 pos；映射只读，可以被多个线程同时调用
+  bool next(size_t &pos, CaptureRecord &record, CaptureKind kind, uint32_t connection_id = kAnyConnection) const;
+  // 第一条记录的位置
+  size_t begin() const;
+
+ private:
+  const char *m_map = nullptr;
+  size_t m_size = 0;
+  size_t m_pos = 0;
+  std::mutex m_mutex;
+};
+
+// 共享同一个 CaptureReader 映射的独立读位置，每个回放的 WebSocket 或 HttpRequest 各用一个
+// 回放同一个抓包文件中不同种类或连接的记录时互不影响
+class CaptureCursor {
+ public:
+  explicit CaptureCursor(std::shared_ptr<const CaptureReader> reader);
+
+  bool next(CaptureRecord &record, CaptureKind kind, uint32_t connection_id = CaptureReader::kAnyConnection);
+  void rewind();
+
+ private:
+  std::shared_ptr<const CaptureReader> m_reader;
+  size_t m_pos;
+};
+
+}  // namespace cpphttp
+
+#endif
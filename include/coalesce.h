@@ -0,0 +1,73 @@
+#ifndef __COMMON_COALESCE_H__
+#define __COMMON_COALESCE_H__
+
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/experimental/concurrent_channel.hpp>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+
+// 合并相同的并发请求：同一 key 同时只有一个网络请求在进行
+// 所有等待者拿到同一份只读、引用计数的响应，失败时每个等待者都会收到同一个异常
+// 网络请求在第一个调用者的执行器上独立运行，任何调用者被取消都不影响其他调用者
+// fetch 只由第一个调用者在 run() 中同步调用一次，它返回的 awaitable 不能引用调用者栈上的对象
+class RequestCoalescer {
+ public:
+  using Response = std::shared_ptr<const std::string>;
+
+  // ignored_headers 中的头部（不区分大小写）不参与 key 计算，例如每次都不同的请求 ID
+  explicit RequestCoalescer(std::vector<std::string> ignored_headers = {});
+
+  // 与 ResponseCache::make_key 相同：包含方法、URL 和所有未忽略的请求头，携带不同凭证的请求不会被合并
+  std::string make_key(const std::string &method, const std::string &url,
+                       const std::map<std::string, std::string> &headers) const;
+
+  asio::awaitable<Response> run(const std::string &key, std::function<asio::awaitable<Response>()> fetch);
+
+  size_t in_flight() const;
+  uint64_t coalesced() const { return m_coalesced; }
+
+ private:
+  using Signal = asio::experimental::concurrent_channel<void(boost::system::error_code)>;
+
+  struct Flight {
+    std::mutex mutex;
+    bool done = false;
+    Response response;
+    std::exception_ptr error;
+    std::vector<std::shared_ptr<Signal>> waiters;
+  };
+
+  // 独立运行的请求持有 State，coalescer 先于请求析构也不会悬空
+  struct State {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+  };
+
+  // fetch 在 request 完成前保持存活，request 可能引用 fetch 的捕获
+  static asio::awaitable<void> fly(std::shared_ptr<State> state, std::string key, std::shared_ptr<Flight> flight,
+                                   std::function<asio::awaitable<Response>()> fetch,
+                                   asio::awaitable<Response> request);
+  // 从 flights 中移除并唤醒所有等待者
+  static void land(State &state, const std::string &key, Flight &flight, Response response, std::exception_ptr error);
+
+  std::vector<std::string> m_ignored_headers;
+  std::shared_ptr<State> m_state = std::make_shared<State>();
+  std::atomic<uint64_t> m_coalesced{0};
+};
+
+}  // namespace cpphttp
+
+#endif
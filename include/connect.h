@@ -6,27 +6,90 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ssl.hpp>
 #include <memory>
+#include <optional>
 #include <string>
 
+#include "endpoint_group.h"
+#include "timestamp_socket.h"
+#include "tls_session.h"
+
 namespace asio = boost::asio;
 
 namespace cpphttp {
 
+// 建立连接时设置的 socket 选项，未设置的项保持系统默认
+// 设置失败时连接抛出 boost::system::system_error，不会静默忽略
+struct SocketOptions {
+  std::optional<bool> no_delay;
+  std::optional<int> recv_buffer;
+  std::optional<int> send_buffer;
+  // SO_BUSY_POLL，单位微秒；超过 net.core.busy_read 时需要 CAP_NET_ADMIN，否则连接抛出 EPERM
+  std::optional<int> busy_poll_us;
+  // TCP_QUICKACK 不是持久选项，内核可能在之后重新进入延迟确认
+  bool quick_ack = false;
+  // TCP_FASTOPEN_CONNECT，持有服务器 cookie 时第一次写入的数据随 SYN 发出，服务器拒绝时内核自动回退
+  // SYN 中的数据可能被网络重放，只应对幂等请求或 TLS 握手开启
+  // 带数据的 connect() 立即返回，连接失败要到第一次读写时才报告，不会再尝试下一个解析地址
+  // 因此开启后 EndpointGroup 不再记录解析地址的连接耗时，只按端点统计
+  bool fast_open = false;
+  // 多个连接共享的 TLS 会话缓存，为空时每次都完整握手
+  std::shared_ptr<TlsSessionCache> session_cache;
+  // TLS 1.3 0-RTT：恢复的会话允许时，Connect::set_early_data() 设置的数据随 ClientHello 发出
+  // 早期数据可以被重放，只应对 GET、HEAD 等安全请求开启（RFC 8470），HttpRequest 会自动关闭其他方法的早期数据；需要 session_cache
+  bool early_data = false;
+
+  // 低延迟配置：关闭 Nagle，开启快速确认，50us 忙轮询
+  // 没有 CAP_NET_ADMIN 且 net.core.busy_read 小于 50 时，需要把 busy_poll_us 置空
+  static SocketOptions low_latency() {
+    SocketOptions options;
+    options.no_delay = true;
+    options.busy_poll_us = 50;
+    options.quick_ack = true;
+    return options;
+  }
+};
+
 class Connect {
  public:
   Connect() = default;
   Connect(const std::string &domain, const int port);
   asio::awaitable<std::unique_ptr<asio::ip::tcp::socket>> connect();
   asio::awaitable<std::unique_ptr<asio::ssl::stream<asio::ip::tcp::socket>>> connect_ssl();
+  // 开启内核软件接收时间戳的连接
+  asio::awaitable<std::unique_ptr<TimestampSocket>> connect_timestamped();
+  asio::awaitable<std::unique_ptr<asio::ssl::stream<TimestampSocket>>> connect_ssl_timestamped();
+
+  // 从第 offset 个解析地址开始尝试连接，用于对冲请求落到不同的 IP 上
+  int set_endpoint_offset(size_t offset);
+  int set_socket_options(const SocketOptions &options);
+  // 按 group 中记录的地址延迟排序解析结果，并把每次连接的耗时和结果记回 group
+  int set_endpoint_group(std::shared_ptr<EndpointGroup> group);
+  // 开启 SocketOptions::early_data 时，TLS 握手前作为早期数据发送的应用数据
+  int set_early_data(std::string data);
+  // 握手完成后查询：早期数据被服务器接受时为 true，否则调用者需要在握手后重新发送
+  bool early_data_accepted() const { return m_early_data_accepted; }
 
   asio::awaitable<std::unique_ptr<asio::ip::tcp::socket>> operator()() {
     co_return co_await connect();
   }
  private:
   asio::awaitable<void> connect_base(asio::ip::tcp::socket &socket);
+  template <typename NextLayer>
+  asio::awaitable<void> handshake_ssl(asio::ssl::stream<NextLayer> &stream);
+  template <typename NextLayer>
+  asio::awaitable<void> write_early_data(asio::ssl::stream<NextLayer> &stream);
+  asio::ssl::context make_ssl_context() const;
 
   std::string m_domain;
   int m_port;
+  size_t m_endpoint_offset = 0;
+  SocketOptions m_socket_options;
+  std::shared_ptr<EndpointGroup> m_group;
+  std::string m_early_data;
+  bool m_early_data_accepted = false;
+
+  void apply_pre_connect(asio::ip::tcp::socket &socket);
+  void apply_post_connect(asio::ip::tcp::socket &socket);
 };
 
 class ConnectSSL : public Connect {
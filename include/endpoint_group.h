@@ -0,0 +1,75 @@
+#ifndef __COMMON_ENDPOINT_GROUP_H__
+#define __COMMON_ENDPOINT_GROUP_H__
+
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+
+// 某个端点或解析地址的统计结果
+struct EndpointScore {
+  double latency_us = 0;
+  double error_rate = 0;
+  uint64_t samples = 0;
+  bool ejected = false;
+};
+
+// 一组等价的 API 端点（scheme://host:port），可以被多个 HttpRequest 和 WebSocket 共享
+// 按端点和解析出的 IP 分别统计 EWMA 延迟和错误率，优先选择期望耗时最小的端点
+// 连续失败 kEjectAfter 次的端点和地址在 eject_time 内不再被选中
+class EndpointGroup {
+ public:
+  EndpointGroup(std::vector<std::string> urls, double exploration = 0.05,
+                std::chrono::milliseconds eject_time = std::chrono::seconds(30), double alpha = 0.2);
+
+  size_t size() const { return m_urls.size(); }
+  const std::string &url(size_t index) const { return m_urls.at(index); }
+
+  // 返回期望耗时第 rank 小的端点，rank 超出可用端点数时返回最后一个
+  // rank 为 0 时以 exploration 的概率随机选择一个可用端点，让慢端点恢复后有机会被重新发现
+  size_t select(size_t rank = 0);
+  void record(size_t index, std::chrono::microseconds latency, bool success);
+  EndpointScore score(size_t index) const;
+
+  // 按地址的期望连接耗时排序解析结果，被剔除的地址排在最后
+  void order(std::vector<asio::ip::tcp::endpoint> &endpoints) const;
+  void record_address(const asio::ip::address &address, std::chrono::microseconds latency, bool success);
+  EndpointScore address_score(const asio::ip::address &address) const;
+
+ private:
+  static constexpr int kEjectAfter = 3;
+
+  struct Stats {
+    double latency_us = 0;
+    double error_rate = 0;
+    uint64_t samples = 0;
+    int consecutive_failures = 0;
+    std::chrono::steady_clock::time_point ejected_until;
+  };
+
+  void update(Stats &stats, std::chrono::microseconds latency, bool success, std::chrono::steady_clock::time_point now);
+  static double cost(const Stats &stats);
+  static EndpointScore to_score(const Stats &stats, std::chrono::steady_clock::time_point now);
+
+  const std::vector<std::string> m_urls;
+  const double m_exploration;
+  const std::chrono::milliseconds m_eject_time;
+  const double m_alpha;
+
+  mutable std::mutex m_mutex;
+  std::vector<Stats> m_endpoints;
+  std::map<asio::ip::address, Stats> m_addresses;
+  std::mt19937 m_rng{std::random_device{}()};
+};
+
+}  // namespace cpphttp
+
+#endif
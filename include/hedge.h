@@ -0,0 +1,51 @@
+#ifndef __COMMON_HEDGE_H__
+#define __COMMON_HEDGE_H__
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace cpphttp {
+
+// 对冲请求策略，可以被多个 HttpRequest 共享
+// 主请求超过 delay() 仍未返回时，向另一个解析地址再发一次，先返回者胜出
+class HedgePolicy {
+ public:
+  HedgePolicy(std::chrono::milliseconds fallback_delay = std::chrono::milliseconds(50), double budget_ratio = 0.05,
+              double percentile = 0.95);
+
+  // 样本足够时返回统计出的延迟分位数，否则返回 fallback_delay
+  std::chrono::microseconds delay() const;
+  void record(std::chrono::microseconds latency);
+
+  // 每个主请求给预算增加 budget_ratio 个令牌，每次对冲消耗一个
+  bool try_acquire();
+  void refund();
+
+  void on_hedge_win() { m_hedges_won++; }
+  uint64_t hedges_sent() const { return m_hedges_sent; }
+  uint64_t hedges_won() const { return m_hedges_won; }
+
+ private:
+  static constexpr size_t kMaxSamples = 256;
+  static constexpr size_t kMinSamples = 20;
+  static constexpr double kMaxTokens = 10.0;
+
+  const std::chrono::milliseconds m_fallback_delay;
+  const double m_budget_ratio;
+  const double m_percentile;
+
+  mutable std::mutex m_mutex;
+  std::vector<int64_t> m_samples;
+  size_t m_next_sample = 0;
+  double m_tokens = 1.0;
+
+  std::atomic<uint64_t> m_hedges_sent{0};
+  std::atomic<uint64_t> m_hedges_won{0};
+};
+
+}  // namespace cpphttp
+
+#endif
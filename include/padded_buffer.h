@@ -0,0 +1,78 @@
+#ifndef __COMMON_PADDED_BUFFER_H__
+#define __COMMON_PADDED_BUFFER_H__
+
+#include <boost/asio/buffer.hpp>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#ifdef CPPHTTP_WITH_SIMDJSON
+#include <simdjson.h>
+#endif
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+
+// 可读数据之后总是保留 kPadding 字节，满足 simdjson 的 SIMDJSON_PADDING 要求
+// 同时实现 DynamicBuffer，Beast 可以直接把 socket 数据读进来，解析前无需再拷贝
+class PaddedBuffer {
+ public:
+  static constexpr size_t kPadding = 64;
+
+  using const_buffers_type = asio::const_buffer;
+  using mutable_buffers_type = asio::mutable_buffer;
+
+  PaddedBuffer() = default;
+  explicit PaddedBuffer(size_t max_size) : m_max_size(max_size) {}
+  PaddedBuffer(PaddedBuffer &&other) noexcept;
+  PaddedBuffer &operator=(PaddedBuffer &&other) noexcept;
+  PaddedBuffer(const PaddedBuffer &other);
+  PaddedBuffer &operator=(const PaddedBuffer &other);
+
+  // 还没有分配时指向一块静态的清零填充，空缓冲区也可以直接交给 simdjson
+  const char *bytes() const { return m_data ? m_data.get() + m_begin : kEmpty; }
+  std::string_view view() const { return std::string_view(bytes(), size()); }
+  operator std::string_view() const { return view(); }
+  std::string str() const { return std::string(view()); }
+  // 从 bytes() 开始可安全读取的字节数，包含填充
+  size_t padded_size() const { return m_data ? m_capacity - m_begin : kPadding; }
+  void clear() { m_begin = m_end = 0; }
+
+  // DynamicBuffer
+  size_t size() const { return m_end - m_begin; }
+  size_t max_size() const { return m_max_size; }
+  size_t capacity() const { return m_capacity > kPadding ? m_capacity - kPadding : 0; }
+  const_buffers_type data() const { return const_buffers_type(m_data.get() + m_begin, size()); }
+  mutable_buffers_type data() { return mutable_buffers_type(m_data.get() + m_begin, size()); }
+  mutable_buffers_type prepare(size_t n);
+  void commit(size_t n);
+  void consume(size_t n);
+
+#ifdef CPPHTTP_WITH_SIMDJSON
+  static_assert(kPadding >= SIMDJSON_PADDING, "PaddedBuffer::kPadding is smaller than SIMDJSON_PADDING");
+
+  simdjson::padded_string_view padded_view() const {
+    return simdjson::padded_string_view(bytes(), size(), padded_size());
+  }
+
+  // 按需解析，返回的 document 引用本缓冲区，使用期间不能修改或销毁缓冲区
+  simdjson::simdjson_result<simdjson::ondemand::document> parse(simdjson::ondemand::parser &parser) const {
+    return parser.iterate(padded_view());
+  }
+#endif
+
+ private:
+  static constexpr char kEmpty[kPadding] = {};
+
+  std::unique_ptr<char[]> m_data;
+  size_t m_capacity = 0;
+  size_t m_begin = 0;
+  size_t m_end = 0;
+  size_t m_max_size = static_cast<size_t>(-1) - kPadding;
+};
+
+}  // namespace cpphttp
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef __COMMON_RELAY_H__
+#define __COMMON_RELAY_H__
+
+#include <boost/asio.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast.hpp>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "WebSocket.h"
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+using tcp = asio::ip::tcp;
+
+// 下游消费过慢、写队列满时的处理方式
+enum class SlowConsumerPolicy {
+  drop_oldest,
+  disconnect,
+};
+
+struct RelayOptions {
+  size_t max_queue = 1024;
+  SlowConsumerPolicy policy = SlowConsumerPolicy::drop_oldest;
+  bool binary = false;
+};
+
+class WebSocketRelay;
+
+// 一个本地订阅者，所有操作都在自己的 strand 上执行
+class RelaySession : public std::enable_shared_from_this<RelaySession> {
+ public:
+  RelaySession(tcp::socket socket, WebSocketRelay &relay);
+  asio::awaitable<void> run();
+  void deliver(std::shared_ptr<const std::string> frame);
+  void close();
+
+ private:
+  asio::awaitable<void> read_loop();
+  asio::awaitable<void> write_loop();
+  void enqueue(std::shared_ptr<const std::string> frame);
+  void shutdown();
+
+  // 只在 run() 期间使用；run() 结束后 m_closing 为 true，之后投递的帧不再访问 relay
+  WebSocketRelay &m_relay;
+  beast::websocket::stream<tcp::socket> m_ws;
+  asio::steady_timer m_signal;
+  std::deque<std::shared_ptr<const std::string>> m_queue;
+  // 握手完成前收到的帧直接丢弃，订阅者只收到加入之后的帧
+  bool m_open = false;
+  bool m_closing = false;
+};
+
+// 持有一条上游连接，把收到的每一帧广播给所有本地 WebSocket 订阅者
+// 每帧只构造一次，各订阅者的写队列共享同一份引用计数的数据
+// 用多个线程调用 io_context::run() 即可横向扩展，relay 必须比 run() 活得久
+// run() 在所有订阅者会话结束后才返回
+class WebSocketRelay {
+ public:
+  WebSocketRelay(asio::io_context &ctx, const std::string &upstream_uri, const tcp::endpoint &listen,
+                 RelayOptions options = {});
+
+  // 上游连接建立后依次发送，用于订阅频道
+  int add_upstream_message(const std::string &msg);
+
+  asio::awaitable<void> run();
+  void stop();
+
+  void broadcast(std::shared_ptr<const std::string> frame);
+  // 已完成 WebSocket 握手的订阅者数量
+  size_t subscriber_count() const { return m_subscribers; }
+  tcp::endpoint local_endpoint() const { return m_acceptor.local_endpoint(); }
+  uint64_t dropped_frames() const { return m_dropped; }
+  uint64_t disconnected_subscribers() const { return m_disconnected; }
+  const RelayOptions &options() const { return m_options; }
+
+ private:
+  friend class RelaySession;
+
+  asio::awaitable<void> serve();
+  asio::awaitable<void> accept_loop();
+  asio::awaitable<void> upstream_loop();
+  void add(std::shared_ptr<RelaySession> session);
+  void remove(std::shared_ptr<RelaySession> session, bool was_open);
+
+  asio::io_context &m_ctx;
+  const std::string m_upstream_uri;
+  std::atomic<bool> m_stopped{false};
+  std::exception_ptr m_upstream_error;
+  const RelayOptions m_options;
+  // accept_loop、upstream_loop 和会话清理都在 acceptor 的 strand 上执行
+  tcp::acceptor m_acceptor;
+  asio::steady_timer m_drained;
+  std::vector<std::string> m_upstream_messages;
+
+  mutable std::mutex m_mutex;
+  // 包括尚未完成握手的会话，stop() 时一起关闭
+  std::unordered_set<std::shared_ptr<RelaySession>> m_sessions;
+
+  std::atomic<size_t> m_subscribers{0};
+  std::atomic<uint64_t> m_dropped{0};
+  std::atomic<uint64_t> m_disconnected{0};
+};
+
+}  // namespace cpphttp
+
+#endif
@@ -10,7 +10,13 @@
 #include <boost/beast.hpp>
 #include <fmt/format.h>
 
+#include "cache.h"
+#include "capture.h"
+#include "coalesce.h"
 #include "connect.h"
+#include "endpoint_group.h"
+#include "hedge.h"
+#include "padded_buffer.h"
 
 namespace cpphttp {
 
@@ -29,8 +35,31 @@ class HttpRequest {
     int set_body(const std::string &content_type, const std::string &body);
     int set_header(const std::string &header_name, const std::string &header_value);
     int set_header(const std::map<std::string, std::string> &headers);
+    // 仅对幂等方法生效，policy 为空时关闭对冲
+    int set_hedge_policy(std::shared_ptr<HedgePolicy> policy);
+    // 仅缓存 GET 请求，cache 为空时关闭缓存
+    int set_cache(std::shared_ptr<ResponseCache> cache);
+    // 仅合并 GET 和 HEAD 请求，coalescer 为空时关闭合并
+    int set_coalescer(std::shared_ptr<RequestCoalescer> coalescer);
+    // 把每次返回给调用者的响应体追加到抓包文件
+    int set_capture(std::shared_ptr<CaptureWriter> capture);
+    // 不再访问网络，按顺序返回抓包文件中的 HTTP 响应
+    // 使用自己的读位置，同一个 replay 可以同时交给其他 HttpRequest 和 WebSocket
+    int set_replay(std::shared_ptr<CaptureReader> replay, uint32_t connection_id = CaptureReader::kAnyConnection);
+    // fast_open 对明文请求只用于幂等方法，early_data 只用于 GET、HEAD 和 OPTIONS
+    int set_socket_options(const SocketOptions &options);
+    // 请求发往 group 中当前最好的端点，URL 只提供路径；group 为空时直接访问 URL 中的主机
+    int set_endpoint_group(std::shared_ptr<EndpointGroup> group);
 
     asio::awaitable<std::string> request();
+    // 返回只读、引用计数的响应体，合并请求和缓存命中时不拷贝
+    asio::awaitable<std::shared_ptr<const std::string>> request_shared();
+    // 响应体直接读入带 SIMD 填充的缓冲区，可以零拷贝交给 simdjson
+    // 不经过 set_cache() 和 set_coalescer()：命中时要把共享的响应体拷贝进填充缓冲区，失去零拷贝的意义
+    asio::awaitable<PaddedBuffer> request_padded();
+    // 通过开启 SO_TIMESTAMPING 的连接请求，返回读取响应时第一次 recvmsg 的内核时间戳，含义见 TimestampSocket::first_rx()
+    // 不经过 set_endpoint_group()：总是直接访问 URL 中的主机，也不记录端点统计
+    asio::awaitable<TimestampedMessage> request_timestamped();
 
   private:
     std::string m_url;
@@ -38,19 +67,89 @@ class HttpRequest {
     std::string m_body;
     std::string m_content_type;
     std::map<std::string, std::string> m_headers;
+    std::shared_ptr<HedgePolicy> m_hedge;
+    std::shared_ptr<ResponseCache> m_cache;
+    std::shared_ptr<RequestCoalescer> m_coalescer;
+    std::shared_ptr<CaptureWriter> m_capture;
+    uint32_t m_capture_id = 0;
+    std::shared_ptr<CaptureCursor> m_replay;
+    uint32_t m_replay_connection = CaptureReader::kAnyConnection;
+    SocketOptions m_socket_options;
+    std::shared_ptr<EndpointGroup> m_group;
 
-    template<typename SocketType>
-    asio::awaitable<std::string> do_request(std::unique_ptr<SocketType> conn, const http::request<http::string_body> &req) {
-      co_await http::async_write(*conn, req, asio::use_awaitable);
+    struct Target {
+      std::string host;
+      int port;
+      bool is_ssl;
+    };
+
+    bool is_safe() const;
+    bool is_idempotent() const;
+    SocketOptions connect_options(const Target &target) const;
+    void on_response(std::string_view body,
+                     std::chrono::system_clock::time_point received = std::chrono::system_clock::now());
+    std::string_view replay_next(CaptureRecord *record = nullptr);
+    static Target parse_target(const std::string &url);
+    http::request<http::string_body> build_request(const Target &target) const;
+
+    // 合并请求在第一个调用者被取消后仍会继续，因此使用请求的独立副本
+    static asio::awaitable<std::shared_ptr<const std::string>> fetch_detached(std::shared_ptr<HttpRequest> self,
+                                                                              Target target,
+                                                                              http::request<http::string_body> req);
+    asio::awaitable<std::shared_ptr<const std::string>> fetch_shared(const Target &target,
+                                                                     http::request<http::string_body> &req);
+    asio::awaitable<std::shared_ptr<const std::string>> cached_send(const Target &target,
+                                                                    http::request<http::string_body> &req);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> send(const Target &target, const http::request<http::string_body> &req);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> fetch(const Target &target, const http::request<http::string_body> &req,
+                                                size_t endpoint_offset);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> fetch_from(const Target &target, const http::request<http::string_body> &req,
+                                                     size_t endpoint_offset);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> timed_fetch(const Target &target, const http::request<http::string_body> &req,
+                                                      std::shared_ptr<HedgePolicy> policy);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> hedged_fetch(const Target &target, const http::request<http::string_body> &req);
+    template<typename Body>
+    asio::awaitable<http::response<Body>> delayed_fetch(const Target &target, const http::request<http::string_body> &req,
+                                                        std::chrono::microseconds delay, bool *fired);
+
+    template<typename Body>
+    static typename Body::value_type take_body(http::response<Body> &res) {
+      if (res.result() != http::status::ok) {
+        throw std::runtime_error(fmt::format("Error: {} - {}", res.result_int(), std::string_view(res.body())));
+      }
+      return std::move(res.body());
+    }
+
+    template<typename Stream>
+    asio::awaitable<http::response<http::string_body>> do_timestamped_request(Stream &stream, TimestampSocket &ts,
+        const http::request<http::string_body> &req, TimestampedMessage &msg) {
+      co_await http::async_write(stream, req, asio::use_awaitable);
+      ts.mark();
       beast::flat_buffer buffer;
       http::response<http::string_body> res;
-      co_await http::async_read(*conn, buffer, res, asio::use_awaitable);
-      
-      if (res.result() != http::status::ok) {
-        throw std::runtime_error(fmt::format("Error: {} - {}", res.result_int(), res.body()));
+      co_await http::async_read(stream, buffer, res, asio::use_awaitable);
+      msg.dequeue = std::chrono::system_clock::now();
+      msg.kernel_rx = ts.first_rx();
+      msg.buffered_rx = ts.mark_rx();
+      co_return res;
+    }
+
+    // sent 为 true 时请求已经作为 TLS 早期数据发出
+    template<typename Body, typename SocketType>
+    asio::awaitable<http::response<Body>> do_request(std::unique_ptr<SocketType> conn, const http::request<http::string_body> &req,
+                                                     bool sent = false) {
+      if (!sent) {
+        co_await http::async_write(*conn, req, asio::use_awaitable);
       }
-      std::string response_body = res.body();
-      co_return response_body;
+      beast::flat_buffer buffer;
+      http::response<Body> res;
+      co_await http::async_read(*conn, buffer, res, asio::use_awaitable);
+      co_return res;
     }
 };
 
@@ -0,0 +1,21 @@
+#ifndef __COMMON_RUNTIME_H__
+#define __COMMON_RUNTIME_H__
+
+#include <boost/asio/io_context.hpp>
+#include <cstddef>
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+
+// 把当前线程绑定到指定 CPU，成功返回 0，失败返回错误码（例如 CPU 不存在或不在 cgroup 允许的范围内时为 EINVAL）
+int pin_thread(int cpu);
+
+// 在当前线程上忙轮询 io_context，代替 io_context::run()
+// 从不进入 epoll_wait 睡眠，唤醒延迟最低，但会占满一个核，适合独占核心的行情线程
+// cpu >= 0 时先绑定到该 CPU，绑定失败时抛出 std::system_error；io_context 停止或没有剩余工作时返回，返回执行的 handler 数量
+size_t run_busy_poll(asio::io_context &ctx, int cpu = -1);
+
+}  // namespace cpphttp
+
+#endif
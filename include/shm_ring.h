@@ -0,0 +1,107 @@
+#ifndef __COMMON_SHM_RING_H__
+#define __COMMON_SHM_RING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace cpphttp {
+
+// 共享内存环形缓冲区，单生产者多消费者，无锁
+// 记录格式：ShmRecordHeader + payload，按 8 字节对齐，写到尾部放不下时用填充记录跳回开头
+// 消费者各自维护读位置，写者超过消费者一整圈时消费者会检测到 overrun
+// 每次 publish 都占用一个 seq，包括因为太大而没有写入的消息，消费者通过 seq 的间隔发现丢失
+
+struct ShmRingHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t capacity;
+  alignas(64) std::atomic<uint64_t> reserve_pos;
+  alignas(64) std::atomic<uint64_t> write_pos;
+};
+
+struct ShmRecordHeader {
+  uint32_t size;
+  uint32_t flags;
+  uint64_t seq;
+  int64_t timestamp_ns;
+};
+
+struct ShmMessage {
+  std::string_view payload;
+  uint64_t seq = 0;
+  int64_t timestamp_ns = 0;
+  uint64_t position = 0;
+};
+
+enum class ShmReadResult {
+  ok,
+  empty,
+  overrun,
+};
+
+class ShmRingWriter {
+ public:
+  // capacity 会向上取整到 2 的幂
+  // 同名的旧段先被 shm_unlink 再重新创建，已经映射旧段的读者不受影响，但要重新打开才能读到新数据
+  ShmRingWriter(const std::string &name, size_t capacity);
+  ~ShmRingWriter();
+  ShmRingWriter(const ShmRingWriter &) = delete;
+  ShmRingWriter &operator=(const ShmRingWriter &) = delete;
+
+  // 同一时间只能有一个线程调用
+  // 记录超过容量一半时不写入并返回 -1，仍然消耗一个 seq 并计入 dropped()
+  int publish(std::string_view payload, int64_t timestamp_ns);
+  int unlink();
+
+  size_t capacity() const { return m_capacity; }
+  uint64_t published() const { return m_seq - m_dropped; }
+  uint64_t dropped() const { return m_dropped; }
+
+ private:
+  std::string m_name;
+  size_t m_capacity;
+  size_t m_map_size;
+  ShmRingHeader *m_header;
+  char *m_data;
+  uint64_t m_seq = 0;
+  uint64_t m_dropped = 0;
+};
+
+class ShmRingReader {
+ public:
+  // 默认从最新位置开始读
+  explicit ShmRingReader(const std::string &name);
+  ~ShmRingReader();
+  ShmRingReader(const ShmRingReader &) = delete;
+  ShmRingReader &operator=(const ShmRingReader &) = delete;
+
+  // 成功时 msg.payload 直接指向共享内存，用完后应调用 valid() 确认期间没有被覆盖
+  ShmReadResult read(ShmMessage &msg);
+  bool valid(const ShmMessage &msg) const;
+  void seek_latest();
+
+  uint64_t overruns() const { return m_overruns; }
+  // 按 seq 间隔统计的丢失消息数，包括 overrun 跳过的和写者因为太大丢弃的
+  uint64_t lost() const { return m_lost; }
+
+ private:
+  ShmReadResult overrun();
+
+  size_t m_capacity;
+  size_t m_map_size;
+  const ShmRingHeader *m_header;
+  const char *m_data;
+  uint64_t m_pos = 0;
+  uint64_t m_overruns = 0;
+  // 下一条消息应有的 seq，0 表示还没有读到过消息
+  uint64_t m_next_seq = 0;
+  uint64_t m_lost = 0;
+};
+
+}  // namespace cpphttp
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef __COMMON_SIMD_H__
+#define __COMMON_SIMD_H__
+
+#include <cstddef>
+
+namespace cpphttp {
+
+// 严格 UTF-8 校验：拒绝过长编码、代理区和超过 U+10FFFF 的码点
+// 首次调用时按 CPU 支持选择 AVX2 / SSE2 / 标量实现；向量化部分快速跳过纯 ASCII 块，遇到多字节字符时逐字符校验
+bool validate_utf8(const char *data, size_t size);
+
+// 当前选择的实现："avx2"、"sse2" 或 "scalar"
+const char *simd_backend();
+
+namespace scalar {
+bool validate_utf8(const char *data, size_t size);
+}  // namespace scalar
+
+}  // namespace cpphttp
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef __COMMON_TIMESTAMP_SOCKET_H__
+#define __COMMON_TIMESTAMP_SOCKET_H__
+
+#include <sys/uio.h>
+
+#include <boost/asio.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/beast/websocket/teardown.hpp>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace cpphttp {
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+
+struct TimestampedMessage {
+  std::string payload;
+  // 读取这条消息时第一次 recvmsg 的内核时间戳，见 TimestampSocket::first_rx()，不支持时为 epoch
+  // 不一定是第一个字节的到达时间：可能是同一次读取中最后一个 TCP 段的时间，也可能晚于已在上层缓存的字节
+  std::chrono::system_clock::time_point kernel_rx;
+  // 开始读取前最后一次从 socket 读到的数据包的内核接收时间，见 TimestampSocket::mark_rx()
+  std::chrono::system_clock::time_point buffered_rx;
+  // 消息交给调用者时的时间
+  std::chrono::system_clock::time_point dequeue;
+};
+
+// 包装 tcp::socket，开启 SO_TIMESTAMPING 软件接收时间戳
+// 读操作用 recvmsg 完成，从控制消息中取出每次读取对应的内核时间戳，可以作为 ssl::stream 或 websocket::stream 的下层
+// TCP 上一次 recvmsg 读到多个段时，控制消息携带的是其中最后一个段的时间戳
+class TimestampSocket {
+ public:
+  using executor_type = asio::ip::tcp::socket::executor_type;
+  using next_layer_type = asio::ip::tcp::socket;
+  using lowest_layer_type = asio::ip::tcp::socket::lowest_layer_type;
+
+  explicit TimestampSocket(asio::ip::tcp::socket socket);
+  TimestampSocket(TimestampSocket &&) = default;
+
+  executor_type get_executor() noexcept { return m_socket.get_executor(); }
+  next_layer_type &next_layer() { return m_socket; }
+  lowest_layer_type &lowest_layer() { return m_socket.lowest_layer(); }
+  const lowest_layer_type &lowest_layer() const { return m_socket.lowest_layer(); }
+  bool timestamping() const { return m_enabled; }
+
+  // 标记一条消息开始读取
+  void mark();
+  // 标记之后第一次 recvmsg 的时间戳；标记之后没有 recvmsg（消息已经整条在上层缓冲区中）时等于 mark_rx()
+  // 它可能晚于第一个字节真正到达的时间，有两种情况：
+  // - 这次 recvmsg 读到了多个 TCP 段，时间戳是最后一个段的到达时间，而不是第一个
+  // - socket 不知道上层（Beast 的读缓冲区、TLS 记录）缓存了多少字节：如果消息开头已经被缓存、其余部分之后才到达，
+  //   第一个字节的到达时间不晚于 mark_rx()
+  std::chrono::system_clock::time_point first_rx() const;
+  // 标记之前最后一次 recvmsg 读到的数据包的时间，是上层已缓存字节到达时间的上界
+  std::chrono::system_clock::time_point mark_rx() const;
+  std::chrono::system_clock::time_point last_rx() const;
+
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers, boost::system::error_code &ec) {
+    while (true) {
+      std::size_t n = 0;
+      ec = receive(buffers, n);
+      if (ec != asio::error::would_block) {
+        return n;
+      }
+      m_socket.wait(asio::ip::tcp::socket::wait_read, ec);
+      if (ec) {
+        return 0;
+      }
+    }
+  }
+
+  template <typename MutableBufferSequence>
+  std::size_t read_some(const MutableBufferSequence &buffers) {
+    boost::system::error_code ec;
+    auto n = read_some(buffers, ec);
+    if (ec) {
+      throw boost::system::system_error(ec, "read_some");
+    }
+    return n;
+  }
+
+  template <typename ConstBufferSequence>
+  std::size_t write_some(const ConstBufferSequence &buffers, boost::system::error_code &ec) {
+    return m_socket.write_some(buffers, ec);
+  }
+
+  template <typename ConstBufferSequence>
+  std::size_t write_some(const ConstBufferSequence &buffers) {
+    return m_socket.write_some(buffers);
+  }
+
+  template <typename MutableBufferSequence, typename ReadToken>
+  auto async_read_some(const MutableBufferSequence &buffers, ReadToken &&token) {
+    enum class State { starting, waiting, posted };
+    return asio::async_compose<ReadToken, void(boost::system::error_code, std::size_t)>(
+        [this, buffers, state = State::starting, result = boost::system::error_code(), n = std::size_t(0)](
+            auto &self, boost::system::error_code ec = {}) mutable {
+          if (state == State::posted) {
+            self.complete(result, n);
+            return;
+          }
+          if (ec) {
+            self.complete(ec, 0);
+            return;
+          }
+
+          // Try the queue first: waiting for readability when data is already there costs a reactor round trip
+          result = receive(buffers, n);
+          if (result == asio::error::would_block) {
+            state = State::waiting;
+            m_socket.async_wait(asio::ip::tcp::socket::wait_read, std::move(self));
+            return;
+          }
+          if (state == State::starting) {
+            // Completed inside the initiating call: defer the handler so it never runs from within it
+            state = State::posted;
+            asio::post(std::move(self));
+            return;
+          }
+          self.complete(result, n);
+        },
+        token, m_socket);
+  }
+
+  template <typename ConstBufferSequence, typename WriteToken>
+  auto async_write_some(const ConstBufferSequence &buffers, WriteToken &&token) {
+    return m_socket.async_write_some(buffers, std::forward<WriteToken>(token));
+  }
+
+ private:
+  static constexpr size_t kMaxIov = 16;
+
+  template <typename MutableBufferSequence>
+  boost::system::error_code receive(const MutableBufferSequence &buffers, std::size_t &n) {
+    iovec iov[kMaxIov];
+    size_t count = 0;
+    for (auto iter = asio::buffer_sequence_begin(buffers); iter != asio::buffer_sequence_end(buffers) && count < kMaxIov;
+         ++iter) {
+      asio::mutable_buffer buffer(*iter);
+      if (buffer.size() > 0) {
+        iov[count].iov_base = buffer.data();
+        iov[count].iov_len = buffer.size();
+        count++;
+      }
+    }
+    return receive(iov, count, n);
+  }
+
+  boost::system::error_code receive(iovec *iov, size_t count, std::size_t &n);
+
+  asio::ip::tcp::socket m_socket;
+  bool m_enabled = false;
+  int64_t m_last_ns = 0;
+  int64_t m_first_ns = 0;
+  int64_t m_mark_ns = 0;
+};
+
+// Beast 通过 ADL 查找，用于 websocket::stream<TimestampSocket> 关闭连接
+void teardown(beast::role_type role, TimestampSocket &socket, boost::system::error_code &ec);
+
+template <typename TeardownHandler>
+void async_teardown(beast::role_type role, TimestampSocket &socket, TeardownHandler &&handler) {
+  beast::websocket::async_teardown(role, socket.next_layer(), std::forward<TeardownHandler>(handler));
+}
+
+}  // namespace cpphttp
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef __COMMON_TLS_SESSION_H__
+#define __COMMON_TLS_SESSION_H__
+
+#include <openssl/ssl.h>
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace cpphttp {
+
+// TLS 会话缓存，可以被多个连接共享
+// 按 host:port 保存服务器下发的会话票据，重连时恢复会话，省掉证书交换和校验
+// TLS 1.3 票据只使用一次（RFC 8446 C.4），每个 key 最多保留 kMaxTickets 张，供并发连接使用
+class TlsSessionCache : public std::enable_shared_from_this<TlsSessionCache> {
+ public:
+  TlsSessionCache() = default;
+  ~TlsSessionCache();
+  TlsSessionCache(const TlsSessionCache &) = delete;
+  TlsSessionCache &operator=(const TlsSessionCache &) = delete;
+
+  // 在 SSL_CTX 上开启客户端会话缓存，并注册接收新票据的回调
+  static void enable(SSL_CTX *ctx);
+
+  // 握手前调用，把连接绑定到 key；有可恢复的会话时返回 true
+  // 取出最新的票据，TLS 1.3 票据从缓存中移除，TLS 1.2 会话保留给后续连接
+  bool attach(SSL *ssl, const std::string &key);
+  // 握手后调用；握手失败时丢弃 key 对应的会话，下次回退到完整握手
+  void on_handshake(SSL *ssl, const std::string &key, bool success);
+
+  // 接管 session 的引用
+  void store(const std::string &key, SSL_SESSION *session);
+  void erase(const std::string &key);
+  // 缓存的票据总数
+  size_t size() const;
+
+  uint64_t resumed() const { return m_resumed; }
+  uint64_t full_handshakes() const { return m_full_handshakes; }
+
+ private:
+  static constexpr size_t kMaxTickets = 4;
+
+  mutable std::mutex m_mutex;
+  std::map<std::string, std::deque<SSL_SESSION *>> m_sessions;
+
+  std::atomic<uint64_t> m_resumed{0};
+  std::atomic<uint64_t> m_full_handshakes{0};
+};
+
+}  // namespace cpphttp
+
+#endif
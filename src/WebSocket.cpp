@@ -12,8 +12,11 @@
 #include <boost/url.hpp>
 #include <boost/url/parse.hpp>
 #include <boost/chrono.hpp>
+#include <cstring>
+#include <exception>
 
 #include "connect.h"
+#include "simd.h"
 
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -42,18 +45,144 @@ int WebSocket::add_uri(const std::string &uri) {
   return 0;
 }
 
+int WebSocket::set_publisher(std::shared_ptr<ShmRingWriter> publisher) {
+  m_publisher = std::move(publisher);
+  return 0;
+}
+
+int WebSocket::set_capture(std::shared_ptr<CaptureWriter> capture) {
+  m_capture = std::move(capture);
+  m_capture_id = m_capture ? m_capture->next_connection_id() : 0;
+  return 0;
+}
+
+int WebSocket::set_replay(std::shared_ptr<CaptureReader> replay, uint32_t connection_id, bool original_speed) {
+  m_replay = replay ? std::make_shared<CaptureCursor>(std::move(replay)) : nullptr;
+  m_replay_connection = connection_id;
+  m_replay_original_speed = original_speed;
+  return 0;
+}
+
+int WebSocket::set_socket_options(const SocketOptions &options) {
+  m_socket_options = options;
+  return 0;
+}
+
+int WebSocket::set_endpoint_group(std::shared_ptr<EndpointGroup> group) {
+  m_group = std::move(group);
+  return 0;
+}
+
+int WebSocket::set_utf8_validation(Utf8Validation mode) {
+  m_utf8_validation = mode;
+  return 0;
+}
+
+int WebSocket::set_rx_timestamping(bool enable) {
+  m_rx_timestamping = enable;
+  return 0;
+}
+
+void WebSocket::validate(std::string_view msg) const {
+  if (m_utf8_validation == Utf8Validation::all && !m_ws_detail->got_text() && !validate_utf8(msg.data(), msg.size())) {
+    throw boost::system::system_error(websocket::error::bad_frame_payload);
+  }
+}
+
+void WebSocket::on_message(std::string_view msg, std::chrono::system_clock::time_point received) {
+  if (!m_publisher && !m_capture) {
+    return;
+  }
+
+  auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(received.time_since_epoch()).count();
+  if (m_publisher) {
+    m_publisher->publish(msg, timestamp);
+  }
+  if (m_capture) {
+    m_capture->append(CaptureKind::websocket, m_capture_id, timestamp, msg);
+  }
+}
+
 asio::awaitable<void> WebSocket::connect() {
-  if (m_is_ssl) {
-    m_ws_detail = std::make_unique<WebSocketDetailWSS>(m_host, m_port, m_path);
+  if (m_replay) {
+    m_ws_detail = std::make_unique<WebSocketDetailReplay>(m_replay, m_replay_connection, m_replay_original_speed);
+    co_await m_ws_detail->connect();
+    co_return;
+  }
+
+  bool is_ssl = m_is_ssl;
+  std::string host = m_host;
+  int port = m_port;
+  size_t index = 0;
+  if (m_group) {
+    index = m_group->select();
+    auto parsedURI = boost::urls::parse_uri(m_group->url(index));
+    if (parsedURI.has_error()) {
+      throw std::invalid_argument("Invalid URI");
+    }
+    is_ssl = parsedURI->scheme() == "wss";
+    host = parsedURI->host();
+    port = parsedURI->port_number();
+    if (port == 0) {
+      port = is_ssl ? 443 : 80;
+    }
+  }
+
+  if (m_rx_timestamping && is_ssl) {
+    m_ws_detail = std::make_unique<WebSocketDetailWSSTimestamped>(host, port, m_path, m_socket_options, m_group);
+  } else if (m_rx_timestamping) {
+    m_ws_detail = std::make_unique<WebSocketDetailWSTimestamped>(host, port, m_path, m_socket_options, m_group);
+  } else if (is_ssl) {
+    m_ws_detail = std::make_unique<WebSocketDetailWSS>(host, port, m_path, m_socket_options, m_group);
   } else {
-    m_ws_detail = std::make_unique<WebSocketDetailWS>(m_host, m_port, m_path);
+    m_ws_detail = std::make_unique<WebSocketDetailWS>(host, port, m_path, m_socket_options, m_group);
+  }
+  if (!m_group) {
+    co_await m_ws_detail->connect();
+    co_return;
+  }
+
+  // Connection setup time (TCP, TLS and upgrade) is what placement optimizes for
+  auto group = m_group;
+  auto start = std::chrono::steady_clock::now();
+  std::exception_ptr error;
+  try {
+    co_await m_ws_detail->connect();
+  } catch (...) {
+    error = std::current_exception();
+  }
+  group->record(index, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start),
+                !error);
+  if (error) {
+    std::rethrow_exception(error);
   }
-  co_await m_ws_detail->connect();
   co_return;
 }
 
 asio::awaitable<std::string> WebSocket::read() {
-  co_return co_await m_ws_detail->read();
+  auto msg = co_await m_ws_detail->read();
+  validate(msg);
+  if (m_publisher || m_capture) {
+    on_message(msg, std::chrono::system_clock::now());
+  }
+  co_return msg;
+}
+
+asio::awaitable<PaddedBuffer> WebSocket::read_padded() {
+  auto msg = co_await m_ws_detail->read_padded();
+  validate(msg.view());
+  if (m_publisher || m_capture) {
+    on_message(msg.view(), std::chrono::system_clock::now());
+  }
+  co_return msg;
+}
+
+asio::awaitable<TimestampedMessage> WebSocket::read_timestamped() {
+  auto msg = co_await m_ws_detail->read_timestamped();
+  validate(msg.payload);
+  // Prefer the kernel arrival time so published and captured timestamps exclude in-process queueing
+  on_message(msg.payload, msg.kernel_rx.time_since_epoch().count() ? msg.kernel_rx : msg.dequeue);
+  co_return msg;
 }
 
 asio::awaitable<void> WebSocket::write(const std::string &msg) {
@@ -74,6 +203,32 @@ asio::awaitable<std::string> WebSocketDetail<WsSocketType>::read() {
   co_return std::string((char *)buffer.data().data(), buffer.data().size());
 }
 
+template <typename WsSocketType>
+asio::awaitable<PaddedBuffer> WebSocketDetail<WsSocketType>::read_padded() {
+  PaddedBuffer buffer;
+  co_await m_ws->async_read(buffer, asio::use_awaitable);
+  co_return buffer;
+}
+
+template <typename WsSocketType>
+asio::awaitable<TimestampedMessage> WebSocketDetail<WsSocketType>::read_timestamped() {
+  auto ts = timestamp_socket();
+  if (ts) {
+    ts->mark();
+  }
+
+  TimestampedMessage msg;
+  beast::flat_buffer buffer;
+  co_await m_ws->async_read(buffer, asio::use_awaitable);
+  msg.dequeue = std::chrono::system_clock::now();
+  if (ts) {
+    msg.kernel_rx = ts->first_rx();
+    msg.buffered_rx = ts->mark_rx();
+  }
+  msg.payload = std::string((char *)buffer.data().data(), buffer.data().size());
+  co_return msg;
+}
+
 template <typename WsSocketType>
 asio::awaitable<void> WebSocketDetail<WsSocketType>::write(const std::string &msg) {
   auto executor = co_await asio::this_coro::executor;
@@ -89,7 +244,10 @@ asio::awaitable<void> WebSocketDetail<WsSocketType>::close() {
 }
 
 asio::awaitable<void> WebSocketDetailWS::connect() {
-  auto base_socket = co_await Connect(this->m_host, this->m_port)();
+  Connect conn(this->m_host, this->m_port);
+  conn.set_socket_options(this->m_socket_options);
+  conn.set_endpoint_group(this->m_group);
+  auto base_socket = co_await conn();
 
   this->m_ws = std::make_unique<beast::websocket::stream<asio::ip::tcp::socket>>(std::move(*base_socket));
   co_await this->m_ws->async_handshake(this->m_host, this->m_path, boost::asio::use_awaitable);
@@ -98,7 +256,10 @@ asio::awaitable<void> WebSocketDetailWS::connect() {
 }
 
 asio::awaitable<void> WebSocketDetailWSS::connect() {
-  auto base_socket = co_await ConnectSSL(this->m_host, this->m_port)();
+  ConnectSSL conn(this->m_host, this->m_port);
+  conn.set_socket_options(this->m_socket_options);
+  conn.set_endpoint_group(this->m_group);
+  auto base_socket = co_await conn();
 
   this->m_ws = std::make_unique<beast::websocket::stream<asio::ssl::stream<asio::ip::tcp::socket>>>(std::move(*base_socket));
 
@@ -106,4 +267,86 @@ asio::awaitable<void> WebSocketDetailWSS::connect() {
   co_return;
 }
 
+asio::awaitable<void> WebSocketDetailWSTimestamped::connect() {
+  Connect conn(this->m_host, this->m_port);
+  conn.set_socket_options(this->m_socket_options);
+  conn.set_endpoint_group(this->m_group);
+  auto base_socket = co_await conn.connect_timestamped();
+
+  this->m_ws = std::make_unique<beast::websocket::stream<TimestampSocket>>(std::move(*base_socket));
+  co_await this->m_ws->async_handshake(this->m_host, this->m_path, boost::asio::use_awaitable);
+
+  co_return;
+}
+
+asio::awaitable<void> WebSocketDetailWSSTimestamped::connect() {
+  ConnectSSL conn(this->m_host, this->m_port);
+  conn.set_socket_options(this->m_socket_options);
+  conn.set_endpoint_group(this->m_group);
+  auto base_socket = co_await conn.connect_ssl_timestamped();
+
+  this->m_ws = std::make_unique<beast::websocket::stream<asio::ssl::stream<TimestampSocket>>>(std::move(*base_socket));
+
+  co_await this->m_ws->async_handshake(this->m_host, this->m_path, asio::cancel_after(10s));
+  co_return;
+}
+
+asio::awaitable<void> WebSocketDetailReplay::connect() {
+  m_first_timestamp = -1;
+  co_return;
+}
+
+asio::awaitable<CaptureRecord> WebSocketDetailReplay::next() {
+  CaptureRecord record;
+  if (!m_reader->next(record, CaptureKind::websocket, m_connection_id)) {
+    throw boost::system::system_error(websocket::error::closed);
+  }
+
+  if (m_original_speed) {
+    if (m_first_timestamp < 0) {
+      m_first_timestamp = record.timestamp_ns;
+      m_start = std::chrono::steady_clock::now();
+    }
+    auto due = m_start + std::chrono::nanoseconds(record.timestamp_ns - m_first_timestamp);
+    if (due > std::chrono::steady_clock::now()) {
+      asio::steady_timer timer(co_await asio::this_coro::executor, due);
+      co_await timer.async_wait(asio::use_awaitable);
+    }
+  }
+  co_return record;
+}
+
+asio::awaitable<std::string> WebSocketDetailReplay::read() {
+  auto record = co_await next();
+  co_return std::string(record.payload);
+}
+
+asio::awaitable<PaddedBuffer> WebSocketDetailReplay::read_padded() {
+  auto record = co_await next();
+  PaddedBuffer buffer;
+  auto n = record.payload.size();
+  std::memcpy(buffer.prepare(n).data(), record.payload.data(), n);
+  buffer.commit(n);
+  co_return buffer;
+}
+
+asio::awaitable<TimestampedMessage> WebSocketDetailReplay::read_timestamped() {
+  auto record = co_await next();
+  TimestampedMessage msg;
+  msg.payload = std::string(record.payload);
+  msg.kernel_rx = std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(record.timestamp_ns)));
+  msg.dequeue = std::chrono::system_clock::now();
+  co_return msg;
+}
+
+asio::awaitable<void> WebSocketDetailReplay::write(const std::string &msg) {
+  // Replayed feeds are one-way, outgoing messages such as subscriptions are dropped
+  co_return;
+}
+
+asio::awaitable<void> WebSocketDetailReplay::close() {
+  co_return;
+}
+
 }  // namespace Common
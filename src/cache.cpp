@@ -0,0 +1,188 @@
+#include "cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace cpphttp {
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+  while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+    value.remove_prefix(1);
+  }
+  while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+
+std::string lower(std::string_view value) {
+  std::string result(value);
+  std::transform(result.begin(), result.end(), result.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return result;
+}
+
+bool iequals(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+}  // namespace
+
+CacheControl CacheControl::parse(std::string_view value) {
+  CacheControl cc;
+  while (!value.empty()) {
+    auto comma = value.find(',');
+    auto directive = trim(value.substr(0, comma));
+    value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+
+    auto eq = directive.find('=');
+    auto name = trim(directive.substr(0, eq));
+    auto arg = eq == std::string_view::npos ? std::string_view() : trim(directive.substr(eq + 1));
+    if (!arg.empty() && arg.front() == '"' && arg.size() >= 2 && arg.back() == '"') {
+      arg = arg.substr(1, arg.size() - 2);
+    }
+
+    if (iequals(name, "no-store")) {
+      cc.no_store = true;
+    } else if (iequals(name, "no-cache")) {
+      cc.no_cache = true;
+    } else if (iequals(name, "max-age")) {
+      long long seconds = 0;
+      auto [ptr, ec] = std::from_chars(arg.data(), arg.data() + arg.size(), seconds);
+      if (ec == std::errc() && seconds >= 0) {
+        cc.max_age = std::chrono::seconds(seconds);
+      }
+    }
+  }
+  return cc;
+}
+
+ResponseCache::ResponseCache(size_t max_bytes, std::vector<std::string> ignored_headers) : m_max_bytes(max_bytes) {
+  for (const auto &header : ignored_headers) {
+    m_ignored_headers.push_back(lower(header));
+  }
+}
+
+std::string ResponseCache::make_key(const std::string &method, const std::string &url,
+                                    const std::map<std::string, std::string> &headers) const {
+  // Sort by lower-cased name so the key does not depend on how callers spelled the headers
+  std::map<std::string, std::string> keyed;
+  for (const auto &header : headers) {
+    auto name = lower(header.first);
+    if (std::find(m_ignored_headers.begin(), m_ignored_headers.end(), name) == m_ignored_headers.end()) {
+      keyed[name] = header.second;
+    }
+  }
+
+  std::string key = method + " " + url;
+  for (const auto &[name, value] : keyed) {
+    key += "\n" + name + ": " + value;
+  }
+  return key;
+}
+
+std::optional<CacheEntry> ResponseCache::lookup(const std::string &key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto iter = m_entries.find(key);
+  if (iter == m_entries.end()) {
+    return std::nullopt;
+  }
+
+  m_lru.splice(m_lru.begin(), m_lru, iter->second.lru);
+  if (iter->second.entry.fresh()) {
+    m_hits++;
+  }
+  return iter->second.entry;
+}
+
+void ResponseCache::store(const std::string &key, std::shared_ptr<const std::string> body,
+                          std::string_view cache_control, std::string_view etag, std::string_view last_modified) {
+  m_misses++;
+
+  auto cc = CacheControl::parse(cache_control);
+  CacheEntry entry;
+  entry.body = std::move(body);
+  entry.etag = etag;
+  entry.last_modified = last_modified;
+  entry.no_cache = cc.no_cache;
+  entry.max_age = cc.max_age.value_or(std::chrono::seconds(0));
+  entry.expires = std::chrono::steady_clock::now() + entry.max_age;
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto iter = m_entries.find(key);
+  if (iter != m_entries.end()) {
+    erase_locked(iter);
+  }
+
+  // Without a lifetime or a validator the entry could never be reused
+  bool reusable = entry.fresh() || entry.has_validator();
+  auto entry_cost = cost(key, entry);
+  if (cc.no_store || !reusable || entry_cost > m_max_bytes) {
+    return;
+  }
+
+  while (m_bytes + entry_cost > m_max_bytes && !m_lru.empty()) {
+    erase_locked(m_entries.find(m_lru.back()));
+  }
+
+  m_lru.push_front(key);
+  m_entries.emplace(key, Node{std::move(entry), m_lru.begin()});
+  m_bytes += entry_cost;
+}
+
+void ResponseCache::revalidated(const std::string &key, std::string_view cache_control) {
+  m_revalidations++;
+
+  auto cc = CacheControl::parse(cache_control);
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto iter = m_entries.find(key);
+  if (iter == m_entries.end()) {
+    return;
+  }
+  if (cc.no_store) {
+    erase_locked(iter);
+    return;
+  }
+  // A 304 without Cache-Control keeps the directives of the stored response
+  auto &entry = iter->second.entry;
+  if (!cache_control.empty()) {
+    entry.no_cache = cc.no_cache;
+    entry.max_age = cc.max_age.value_or(std::chrono::seconds(0));
+  }
+  entry.expires = std::chrono::steady_clock::now() + entry.max_age;
+}
+
+void ResponseCache::erase(const std::string &key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto iter = m_entries.find(key);
+  if (iter != m_entries.end()) {
+    erase_locked(iter);
+  }
+}
+
+size_t ResponseCache::size_bytes() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_bytes;
+}
+
+size_t ResponseCache::entries() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_entries.size();
+}
+
+void ResponseCache::erase_locked(std::unordered_map<std::string, Node>::iterator iter) {
+  m_bytes -= cost(iter->first, iter->second.entry);
+  m_lru.erase(iter->second.lru);
+  m_entries.erase(iter);
+}
+
+size_t ResponseCache::cost(const std::string &key, const CacheEntry &entry) {
+  return key.size() + (entry.body ? entry.body->size() : 0) + entry.etag.size() + entry.last_modified.size();
+}
+
+}  // namespace cpphttp
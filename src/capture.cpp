@@ -0,0 +1,181 @@
+#include "capture.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace cpphttp {
+
+namespace {
+
+constexpr char kMagic[8] = {'C', 'P', 'H', 'C', 'A', 'P', '0', '1'};
+constexpr size_t kFileHeaderSize = 64;
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+std::runtime_error sys_error(const char *what) {
+  return std::runtime_error(std::string(what) + " failed: " + std::strerror(errno));
+}
+
+}  // namespace
+
+CaptureWriter::CaptureWriter(const std::string &path, size_t initial_size) {
+  m_fd = ::open(path.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+  if (m_fd < 0) {
+    throw sys_error("open");
+  }
+
+  m_mapped = std::max(align8(initial_size), size_t(4096));
+  if (ftruncate(m_fd, m_mapped) != 0) {
+    ::close(m_fd);
+    throw sys_error("ftruncate");
+  }
+
+  void *addr = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (addr == MAP_FAILED) {
+    ::close(m_fd);
+    throw sys_error("mmap");
+  }
+  m_map = static_cast<char *>(addr);
+  std::memcpy(m_map, kMagic, sizeof(kMagic));
+  m_end = kFileHeaderSize;
+}
+
+CaptureWriter::~CaptureWriter() { close(); }
+
+int CaptureWriter::append(CaptureKind kind, uint32_t connection_id, int64_t timestamp_ns, std::string_view payload) {
+  if (payload.size() > UINT32_MAX) {
+    return -1;
+  }
+
+  size_t record_size = align8(sizeof(CaptureRecordHeader) + payload.size());
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) {
+    return -1;
+  }
+  // Always leave room for the zeroed end marker
+  if (m_end + record_size + sizeof(CaptureRecordHeader) > m_mapped) {
+    grow(m_end + record_size + sizeof(CaptureRecordHeader));
+  }
+
+  CaptureRecordHeader header{};
+  header.size = static_cast<uint32_t>(payload.size());
+  header.connection_id = connection_id;
+  header.kind = static_cast<uint8_t>(kind);
+  header.timestamp_ns = timestamp_ns;
+  std::memcpy(m_map + m_end, &header, sizeof(header));
+  std::memcpy(m_map + m_end + sizeof(header), payload.data(), payload.size());
+  m_end += record_size;
+  m_records++;
+  return 0;
+}
+
+void CaptureWriter::grow(size_t needed) {
+  size_t size = std::max(needed, m_mapped * 2);
+  if (ftruncate(m_fd, size) != 0) {
+    throw sys_error("ftruncate");
+  }
+  void *addr = mremap(m_map, m_mapped, size, MREMAP_MAYMOVE);
+  if (addr == MAP_FAILED) {
+    throw sys_error("mremap");
+  }
+  m_map = static_cast<char *>(addr);
+  m_mapped = size;
+}
+
+int CaptureWriter::close() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (!m_map) {
+    return 0;
+  }
+
+  munmap(m_map, m_mapped);
+  m_map = nullptr;
+  // Keep a zeroed header after the last record as the end marker
+  int ret = ftruncate(m_fd, m_end + sizeof(CaptureRecordHeader));
+  ::close(m_fd);
+  m_fd = -1;
+  return ret;
+}
+
+CaptureReader::CaptureReader(const std::string &path) {
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw sys_error("open");
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kFileHeaderSize) {
+    ::close(fd);
+    throw std::runtime_error("Invalid capture file");
+  }
+
+  m_size = st.st_size;
+  void *addr = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (addr == MAP_FAILED) {
+    throw sys_error("mmap");
+  }
+
+  m_map = static_cast<const char *>(addr);
+  if (std::memcmp(m_map, kMagic, sizeof(kMagic)) != 0) {
+    munmap(addr, m_size);
+    throw std::runtime_error("Invalid capture file");
+  }
+  madvise(addr, m_size, MADV_SEQUENTIAL);
+  m_pos = begin();
+}
+
+CaptureReader::~CaptureReader() { munmap(const_cast<char *>(m_map), m_size); }
+
+bool CaptureReader::next(CaptureRecord &record, CaptureKind kind, uint32_t connection_id) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return next(m_pos, record, kind, connection_id);
+}
+
+void CaptureReader::rewind() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_pos = begin();
+}
+
+bool CaptureReader::next(size_t &pos, CaptureRecord &record, CaptureKind kind, uint32_t connection_id) const {
+  while (pos + sizeof(CaptureRecordHeader) <= m_size) {
+    CaptureRecordHeader header;
+    std::memcpy(&header, m_map + pos, sizeof(header));
+    if (header.kind == 0 || pos + sizeof(header) + header.size > m_size) {
+      return false;
+    }
+
+    size_t start = pos;
+    pos += align8(sizeof(header) + header.size);
+    if (header.kind != static_cast<uint8_t>(kind) ||
+        (connection_id != kAnyConnection && header.connection_id != connection_id)) {
+      continue;
+    }
+
+    record.payload = std::string_view(m_map + start + sizeof(header), header.size);
+    record.connection_id = header.connection_id;
+    record.kind = kind;
+    record.timestamp_ns = header.timestamp_ns;
+    return true;
+  }
+  return false;
+}
+
+size_t CaptureReader::begin() const { return kFileHeaderSize; }
+
+CaptureCursor::CaptureCursor(std::shared_ptr<const CaptureReader> reader)
+    : m_reader(std::move(reader)), m_pos(m_reader->begin()) {}
+
+bool CaptureCursor::next(CaptureRecord &record, CaptureKind kind, uint32_t connection_id) {
+  return m_reader->next(m_pos, record, kind, connection_id);
+}
+
+void CaptureCursor::rewind() { m_pos = m_reader->begin(); }
+
+}  // namespace cpphttp
@@ -0,0 +1,134 @@
+#include "coalesce.h"
+
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <algorithm>
+#include <cctype>
+#include <optional>
+
+namespace cpphttp {
+
+namespace {
+
+std::string lower(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(),
+                 [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return value;
+}
+
+}  // namespace
+
+RequestCoalescer::RequestCoalescer(std::vector<std::string> ignored_headers) {
+  for (auto &header : ignored_headers) {
+    m_ignored_headers.push_back(lower(std::move(header)));
+  }
+}
+
+std::string RequestCoalescer::make_key(const std::string &method, const std::string &url,
+                                       const std::map<std::string, std::string> &headers) const {
+  // Sort by lower-cased name so the key does not depend on how callers spelled the headers
+  std::map<std::string, std::string> keyed;
+  for (const auto &header : headers) {
+    auto name = lower(header.first);
+    if (std::find(m_ignored_headers.begin(), m_ignored_headers.end(), name) == m_ignored_headers.end()) {
+      keyed[name] = header.second;
+    }
+  }
+
+  std::string key = method + " " + url;
+  for (const auto &[name, value] : keyed) {
+    key += "\n" + name + ": " + value;
+  }
+  return key;
+}
+
+asio::awaitable<RequestCoalescer::Response> RequestCoalescer::run(const std::string &key,
+                                                                  std::function<asio::awaitable<Response>()> fetch) {
+  auto executor = co_await asio::this_coro::executor;
+  std::shared_ptr<Flight> flight;
+  bool leader = false;
+  {
+    std::lock_guard<std::mutex> lock(m_state->mutex);
+    auto &slot = m_state->flights[key];
+    if (!slot) {
+      slot = std::make_shared<Flight>();
+      leader = true;
+    }
+    flight = slot;
+  }
+
+  if (leader) {
+    // Detached so that cancelling or destroying the first caller does not abort the request for everyone else
+    std::optional<asio::awaitable<Response>> request;
+    try {
+      request = fetch();
+    } catch (...) {
+      land(*m_state, key, *flight, nullptr, std::current_exception());
+    }
+    if (request) {
+      asio::co_spawn(executor, fly(m_state, key, flight, std::move(fetch), std::move(*request)), asio::detached);
+    }
+  } else {
+    m_coalesced++;
+  }
+
+  // The channel buffers one notification, so a wakeup sent before we start waiting is not lost
+  auto signal = std::make_shared<Signal>(executor, 1);
+  bool wait = false;
+  {
+    std::lock_guard<std::mutex> lock(flight->mutex);
+    if (!flight->done) {
+      flight->waiters.push_back(signal);
+      wait = true;
+    }
+  }
+  if (wait) {
+    co_await signal->async_receive(asio::use_awaitable);
+  }
+
+  if (flight->error) {
+    std::rethrow_exception(flight->error);
+  }
+  co_return flight->response;
+}
+
+asio::awaitable<void> RequestCoalescer::fly(std::shared_ptr<State> state, std::string key,
+                                            std::shared_ptr<Flight> flight,
+                                            std::function<asio::awaitable<Response>()> fetch,
+                                            asio::awaitable<Response> request) {
+  Response response;
+  std::exception_ptr error;
+  try {
+    response = co_await std::move(request);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  land(*state, key, *flight, std::move(response), error);
+}
+
+void RequestCoalescer::land(State &state, const std::string &key, Flight &flight, Response response,
+                            std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.flights.erase(key);
+  }
+
+  std::vector<std::shared_ptr<Signal>> waiters;
+  {
+    std::lock_guard<std::mutex> lock(flight.mutex);
+    flight.done = true;
+    flight.response = std::move(response);
+    flight.error = error;
+    waiters.swap(flight.waiters);
+  }
+  for (const auto &waiter : waiters) {
+    waiter->try_send(boost::system::error_code());
+  }
+}
+
+size_t RequestCoalescer::in_flight() const {
+  std::lock_guard<std::mutex> lock(m_state->mutex);
+  return m_state->flights.size();
+}
+
+}  // namespace cpphttp
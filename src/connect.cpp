@@ -1,13 +1,55 @@
 #include "connect.h"
 
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
 #include <boost/system.hpp>
+#include <boost/asio/as_tuple.hpp>
 #include <boost/asio/ssl.hpp>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <memory>
+#include <tuple>
+#include <vector>
 
 namespace cpphttp {
 
+namespace {
+
+// Options asio has no wrapper for; failures throw like socket::set_option() does
+void set_int_option(asio::ip::tcp::socket &socket, int level, int name, int value) {
+  if (setsockopt(socket.native_handle(), level, name, &value, sizeof(value)) != 0) {
+    throw boost::system::system_error(boost::system::error_code(errno, boost::system::system_category()),
+                                      "setsockopt");
+  }
+}
+
+}  // namespace
+
 Connect::Connect(const std::string &domain, const int port) : m_domain(domain), m_port(port) {}
 
+int Connect::set_endpoint_offset(size_t offset) {
+  m_endpoint_offset = offset;
+  return 0;
+}
+
+int Connect::set_socket_options(const SocketOptions &options) {
+  m_socket_options = options;
+  return 0;
+}
+
+int Connect::set_endpoint_group(std::shared_ptr<EndpointGroup> group) {
+  m_group = std::move(group);
+  return 0;
+}
+
+int Connect::set_early_data(std::string data) {
+  m_early_data = std::move(data);
+  return 0;
+}
+
 asio::awaitable<std::unique_ptr<asio::ip::tcp::socket>> Connect::connect() {
   auto executor = co_await asio::this_coro::executor;
   auto socket = std::make_unique<asio::ip::tcp::socket>(executor);
@@ -18,18 +60,92 @@ asio::awaitable<std::unique_ptr<asio::ip::tcp::socket>> Connect::connect() {
 
 asio::awaitable<std::unique_ptr<asio::ssl::stream<asio::ip::tcp::socket>>> Connect::connect_ssl() {
   auto executor = co_await asio::this_coro::executor;
+  auto ssl_ctx = make_ssl_context();
+
+  auto socket = std::make_unique<asio::ssl::stream<asio::ip::tcp::socket>>(executor, ssl_ctx);
+  co_await connect_base(socket->next_layer());
+  co_await handshake_ssl(*socket);
+  co_return socket;
+}
+
+asio::awaitable<std::unique_ptr<TimestampSocket>> Connect::connect_timestamped() {
+  auto socket = co_await connect();
+  co_return std::make_unique<TimestampSocket>(std::move(*socket));
+}
+
+asio::awaitable<std::unique_ptr<asio::ssl::stream<TimestampSocket>>> Connect::connect_ssl_timestamped() {
+  auto ssl_ctx = make_ssl_context();
+  auto socket = co_await connect();
+
+  auto stream = std::make_unique<asio::ssl::stream<TimestampSocket>>(TimestampSocket(std::move(*socket)), ssl_ctx);
+  co_await handshake_ssl(*stream);
+  co_return stream;
+}
+
+asio::ssl::context Connect::make_ssl_context() const {
   asio::ssl::context ssl_ctx(asio::ssl::context::tls_client);
   ssl_ctx.set_options(asio::ssl::context::default_workarounds | asio::ssl::context::single_dh_use);
   ssl_ctx.set_default_verify_paths(); // 使用系统证书库
+  if (m_socket_options.session_cache) {
+    TlsSessionCache::enable(ssl_ctx.native_handle());
+  }
+  return ssl_ctx;
+}
 
-  auto socket = std::make_unique<asio::ssl::stream<asio::ip::tcp::socket>>(executor, ssl_ctx);
-  co_await connect_base(socket->next_layer());
-  if (!SSL_set_tlsext_host_name(socket->native_handle(), m_domain.c_str())) {
+template <typename NextLayer>
+asio::awaitable<void> Connect::handshake_ssl(asio::ssl::stream<NextLayer> &stream) {
+  if (!SSL_set_tlsext_host_name(stream.native_handle(), m_domain.c_str())) {
     throw std::runtime_error("Unable to set SNI hostname");
   }
-  
-  co_await socket->async_handshake(asio::ssl::stream_base::client, asio::use_awaitable);
-  co_return socket;
+
+  auto cache = m_socket_options.session_cache;
+  if (!cache) {
+    co_await stream.async_handshake(asio::ssl::stream_base::client, asio::use_awaitable);
+    co_return;
+  }
+
+  auto key = m_domain + ":" + std::to_string(m_port);
+  auto *ssl = stream.native_handle();
+  m_early_data_accepted = false;
+  bool early = cache->attach(ssl, key) && m_socket_options.early_data && !m_early_data.empty() &&
+               SSL_SESSION_get_max_early_data(SSL_get0_session(ssl)) >= m_early_data.size();
+  if (early) {
+    co_await write_early_data(stream);
+  }
+  auto [ec] = co_await stream.async_handshake(asio::ssl::stream_base::client, asio::as_tuple(asio::use_awaitable));
+  cache->on_handshake(ssl, key, !ec);
+  if (ec) {
+    throw boost::system::system_error(ec);
+  }
+  m_early_data_accepted = early && SSL_get_early_data_status(ssl) == SSL_EARLY_DATA_ACCEPTED;
+}
+
+template <typename NextLayer>
+asio::awaitable<void> Connect::write_early_data(asio::ssl::stream<NextLayer> &stream) {
+  // The stream's engine only sends output produced by its own operations, so the ClientHello and
+  // early data are written into a memory BIO and sent directly; the handshake then carries on as usual
+  auto *ssl = stream.native_handle();
+  BIO *wbio = SSL_get_wbio(ssl);
+  BIO *memory = BIO_new(BIO_s_mem());
+  if (!memory) {
+    throw std::runtime_error("Unable to write early data");
+  }
+  BIO_up_ref(wbio);
+  SSL_set0_wbio(ssl, memory);
+
+  size_t written = 0;
+  bool ok = SSL_write_early_data(ssl, m_early_data.data(), m_early_data.size(), &written) == 1;
+  std::string output;
+  char *data = nullptr;
+  long size = BIO_get_mem_data(memory, &data);
+  if (ok && size > 0) {
+    output.assign(data, size);
+  }
+  SSL_set0_wbio(ssl, wbio);
+  if (!ok) {
+    throw std::runtime_error("Unable to write early data");
+  }
+  co_await asio::async_write(stream.next_layer(), asio::buffer(output), asio::use_awaitable);
 }
 
 asio::awaitable<void> Connect::connect_base(asio::ip::tcp::socket &socket) {
@@ -40,7 +156,64 @@ asio::awaitable<void> Connect::connect_base(asio::ip::tcp::socket &socket) {
   if (points.empty()) {
     throw std::runtime_error("Unable to get address");
   }
-  co_await asio::async_connect(socket, points, asio::use_awaitable);
+
+  std::vector<asio::ip::tcp::endpoint> endpoints(points.begin(), points.end());
+  if (m_group) {
+    m_group->order(endpoints);
+  }
+  std::rotate(endpoints.begin(), endpoints.begin() + (m_endpoint_offset % endpoints.size()), endpoints.end());
+
+  // Connect one endpoint at a time so options that must precede connect() can be applied to each fresh socket
+  boost::system::error_code ec;
+  for (const auto &endpoint : endpoints) {
+    socket.close(ec);
+    socket.open(endpoint.protocol());
+    apply_pre_connect(socket);
+
+    auto start = std::chrono::steady_clock::now();
+    std::tie(ec) = co_await socket.async_connect(endpoint, asio::as_tuple(asio::use_awaitable));
+    // With Fast Open connect() completes before the handshake, so its time says nothing about the address
+    if (m_group && !m_socket_options.fast_open && ec != asio::error::operation_aborted) {
+      m_group->record_address(endpoint.address(),
+                              std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start),
+                              !ec);
+    }
+    if (!ec) {
+      apply_post_connect(socket);
+      co_return;
+    }
+    if (ec == asio::error::operation_aborted) {
+      break;
+    }
+  }
+  throw boost::system::system_error(ec);
+}
+
+void Connect::apply_pre_connect(asio::ip::tcp::socket &socket) {
+  // Buffer sizes must be set before the handshake to affect the advertised window scale
+  if (m_socket_options.recv_buffer) {
+    socket.set_option(asio::socket_base::receive_buffer_size(*m_socket_options.recv_buffer));
+  }
+  if (m_socket_options.send_buffer) {
+    socket.set_option(asio::socket_base::send_buffer_size(*m_socket_options.send_buffer));
+  }
+  if (m_socket_options.busy_poll_us) {
+    set_int_option(socket, SOL_SOCKET, SO_BUSY_POLL, *m_socket_options.busy_poll_us);
+  }
+#ifdef TCP_FASTOPEN_CONNECT
+  if (m_socket_options.fast_open) {
+    set_int_option(socket, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, 1);
+  }
+#endif
+}
+
+void Connect::apply_post_connect(asio::ip::tcp::socket &socket) {
+  if (m_socket_options.no_delay) {
+    socket.set_option(asio::ip::tcp::no_delay(*m_socket_options.no_delay));
+  }
+  if (m_socket_options.quick_ack) {
+    set_int_option(socket, IPPROTO_TCP, TCP_QUICKACK, 1);
+  }
 }
 
 }
@@ -0,0 +1,121 @@
+#include "endpoint_group.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+namespace cpphttp {
+
+EndpointGroup::EndpointGroup(std::vector<std::string> urls, double exploration, std::chrono::milliseconds eject_time,
+                             double alpha)
+    : m_urls(std::move(urls)), m_exploration(exploration), m_eject_time(eject_time), m_alpha(alpha),
+      m_endpoints(m_urls.size()) {
+  if (m_urls.empty()) {
+    throw std::invalid_argument("EndpointGroup requires at least one endpoint");
+  }
+}
+
+double EndpointGroup::cost(const Stats &stats) {
+  // Untried endpoints sort first so every endpoint gets sampled at least once;
+  // ones that have only ever failed sort last
+  if (stats.samples == 0) {
+    return stats.error_rate > 0 ? std::numeric_limits<double>::max() : 0;
+  }
+  // Expected time until a success when each attempt fails with probability error_rate
+  return stats.latency_us / std::max(1.0 - stats.error_rate, 0.05);
+}
+
+EndpointScore EndpointGroup::to_score(const Stats &stats, std::chrono::steady_clock::time_point now) {
+  return EndpointScore{stats.latency_us, stats.error_rate, stats.samples, stats.ejected_until > now};
+}
+
+void EndpointGroup::update(Stats &stats, std::chrono::microseconds latency, bool success,
+                           std::chrono::steady_clock::time_point now) {
+  stats.error_rate = m_alpha * (success ? 0.0 : 1.0) + (1 - m_alpha) * stats.error_rate;
+  if (!success) {
+    // The time until a failure says nothing about how fast a success would have been
+    if (++stats.consecutive_failures >= kEjectAfter) {
+      stats.ejected_until = now + m_eject_time;
+      stats.consecutive_failures = 0;
+    }
+    return;
+  }
+
+  stats.consecutive_failures = 0;
+  auto sample = static_cast<double>(latency.count());
+  stats.latency_us = stats.samples == 0 ? sample : m_alpha * sample + (1 - m_alpha) * stats.latency_us;
+  stats.samples++;
+}
+
+size_t EndpointGroup::select(size_t rank) {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  std::vector<size_t> candidates;
+  for (size_t i = 0; i < m_endpoints.size(); i++) {
+    if (m_endpoints[i].ejected_until <= now) {
+      candidates.push_back(i);
+    }
+  }
+  if (candidates.empty()) {
+    // Everything is ejected: fall back to the endpoint that comes back first rather than failing outright
+    candidates.resize(m_endpoints.size());
+    std::iota(candidates.begin(), candidates.end(), 0);
+    std::stable_sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+      return m_endpoints[a].ejected_until < m_endpoints[b].ejected_until;
+    });
+    return candidates[std::min(rank, candidates.size() - 1)];
+  }
+
+  if (rank == 0 && candidates.size() > 1 && std::uniform_real_distribution<double>(0, 1)(m_rng) < m_exploration) {
+    return candidates[std::uniform_int_distribution<size_t>(0, candidates.size() - 1)(m_rng)];
+  }
+
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [this](size_t a, size_t b) { return cost(m_endpoints[a]) < cost(m_endpoints[b]); });
+  return candidates[std::min(rank, candidates.size() - 1)];
+}
+
+void EndpointGroup::record(size_t index, std::chrono::microseconds latency, bool success) {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  update(m_endpoints.at(index), latency, success, now);
+}
+
+EndpointScore EndpointGroup::score(size_t index) const {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return to_score(m_endpoints.at(index), now);
+}
+
+void EndpointGroup::order(std::vector<asio::ip::tcp::endpoint> &endpoints) const {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  auto rank = [this, now](const asio::ip::tcp::endpoint &endpoint) {
+    auto it = m_addresses.find(endpoint.address());
+    if (it == m_addresses.end()) {
+      return std::make_pair(false, 0.0);
+    }
+    return std::make_pair(it->second.ejected_until > now, cost(it->second));
+  };
+  // Stable so addresses with equal scores keep the resolver's order
+  std::stable_sort(endpoints.begin(), endpoints.end(),
+                   [&rank](const auto &a, const auto &b) { return rank(a) < rank(b); });
+}
+
+void EndpointGroup::record_address(const asio::ip::address &address, std::chrono::microseconds latency, bool success) {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  update(m_addresses[address], latency, success, now);
+}
+
+EndpointScore EndpointGroup::address_score(const asio::ip::address &address) const {
+  auto now = std::chrono::steady_clock::now();
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_addresses.find(address);
+  return it == m_addresses.end() ? EndpointScore{} : to_score(it->second, now);
+}
+
+}  // namespace cpphttp
@@ -0,0 +1,54 @@
+#include "hedge.h"
+
+#include <algorithm>
+
+namespace cpphttp {
+
+HedgePolicy::HedgePolicy(std::chrono::milliseconds fallback_delay, double budget_ratio, double percentile)
+    : m_fallback_delay(fallback_delay), m_budget_ratio(budget_ratio), m_percentile(std::clamp(percentile, 0.0, 1.0)) {
+  m_samples.reserve(kMaxSamples);
+}
+
+std::chrono::microseconds HedgePolicy::delay() const {
+  std::vector<int64_t> samples;
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_samples.size() < kMinSamples) {
+      return std::chrono::duration_cast<std::chrono::microseconds>(m_fallback_delay);
+    }
+    samples = m_samples;
+  }
+
+  auto nth = samples.begin() + static_cast<size_t>(m_percentile * (samples.size() - 1));
+  std::nth_element(samples.begin(), nth, samples.end());
+  return std::chrono::microseconds(*nth);
+}
+
+void HedgePolicy::record(std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_samples.size() < kMaxSamples) {
+    m_samples.push_back(latency.count());
+  } else {
+    m_samples[m_next_sample] = latency.count();
+  }
+  m_next_sample = (m_next_sample + 1) % kMaxSamples;
+}
+
+bool HedgePolicy::try_acquire() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tokens = std::min(m_tokens + m_budget_ratio, kMaxTokens);
+  if (m_tokens < 1.0) {
+    return false;
+  }
+  m_tokens -= 1.0;
+  m_hedges_sent++;
+  return true;
+}
+
+void HedgePolicy::refund() {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_tokens = std::min(m_tokens + 1.0, kMaxTokens);
+  m_hedges_sent--;
+}
+
+}  // namespace cpphttp
@@ -0,0 +1,90 @@
+#include "padded_buffer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace cpphttp {
+
+PaddedBuffer::PaddedBuffer(PaddedBuffer &&other) noexcept
+    : m_data(std::move(other.m_data)),
+      m_capacity(other.m_capacity),
+      m_begin(other.m_begin),
+      m_end(other.m_end),
+      m_max_size(other.m_max_size) {
+  other.m_capacity = other.m_begin = other.m_end = 0;
+}
+
+PaddedBuffer &PaddedBuffer::operator=(PaddedBuffer &&other) noexcept {
+  if (this != &other) {
+    m_data = std::move(other.m_data);
+    m_capacity = other.m_capacity;
+    m_begin = other.m_begin;
+    m_end = other.m_end;
+    m_max_size = other.m_max_size;
+    other.m_capacity = other.m_begin = other.m_end = 0;
+  }
+  return *this;
+}
+
+PaddedBuffer::PaddedBuffer(const PaddedBuffer &other) : m_max_size(other.m_max_size) {
+  *this = other;
+}
+
+PaddedBuffer &PaddedBuffer::operator=(const PaddedBuffer &other) {
+  if (this != &other) {
+    m_max_size = other.m_max_size;
+    clear();
+    auto n = other.size();
+    if (n > 0) {
+      std::memcpy(prepare(n).data(), other.bytes(), n);
+      commit(n);
+    }
+  }
+  return *this;
+}
+
+PaddedBuffer::mutable_buffers_type PaddedBuffer::prepare(size_t n) {
+  if (n > m_max_size - size()) {
+    throw std::length_error("PaddedBuffer overflow");
+  }
+
+  if (m_end + n + kPadding > m_capacity) {
+    auto readable = size();
+    auto needed = readable + n + kPadding;
+    if (needed <= m_capacity) {
+      // Enough room once the consumed prefix is reclaimed
+      std::memmove(m_data.get(), m_data.get() + m_begin, readable);
+    } else {
+      auto capacity = std::max(needed, m_capacity * 2);
+      auto data = std::make_unique_for_overwrite<char[]>(capacity);
+      if (readable > 0) {
+        std::memcpy(data.get(), m_data.get() + m_begin, readable);
+      }
+      m_data = std::move(data);
+      m_capacity = capacity;
+    }
+    m_begin = 0;
+    m_end = readable;
+  }
+
+  return mutable_buffers_type(m_data.get() + m_end, n);
+}
+
+void PaddedBuffer::commit(size_t n) {
+  if (!m_data) {
+    return;
+  }
+  m_end += std::min(n, m_capacity - kPadding - m_end);
+  // Keep the padding zeroed for parsers that peek past the end
+  std::memset(m_data.get() + m_end, 0, kPadding);
+}
+
+void PaddedBuffer::consume(size_t n) {
+  m_begin += std::min(n, size());
+  if (m_begin == m_end) {
+    m_begin = m_end = 0;
+  }
+}
+
+}  // namespace cpphttp
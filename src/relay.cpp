@@ -0,0 +1,228 @@
+#include "relay.h"
+
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/strand.hpp>
+
+namespace cpphttp {
+
+RelaySession::RelaySession(tcp::socket socket, WebSocketRelay &relay)
+    : m_relay(relay), m_ws(std::move(socket)), m_signal(m_ws.get_executor()) {}
+
+asio::awaitable<void> RelaySession::run() {
+  using namespace asio::experimental::awaitable_operators;
+  auto self = shared_from_this();
+
+  try {
+    m_ws.set_option(beast::websocket::stream_base::timeout::suggested(beast::role_type::server));
+    co_await m_ws.async_accept(asio::use_awaitable);
+    m_ws.binary(m_relay.options().binary);
+  } catch (const std::exception &) {
+    m_closing = true;
+    m_relay.remove(self, false);
+    co_return;
+  }
+
+  if (!m_closing) {
+    m_open = true;
+    m_relay.m_subscribers++;
+    // Both loops return normally on error so the survivor gets cancelled
+    co_await (read_loop() || write_loop());
+  }
+  // Last use of m_relay: run() may return and the relay be destroyed once this is processed
+  m_relay.remove(self, m_open);
+}
+
+void RelaySession::deliver(std::shared_ptr<const std::string> frame) {
+  asio::post(m_ws.get_executor(), [self = shared_from_this(), frame = std::move(frame)]() mutable {
+    self->enqueue(std::move(frame));
+  });
+}
+
+void RelaySession::close() {
+  asio::post(m_ws.get_executor(), [self = shared_from_this()]() { self->shutdown(); });
+}
+
+void RelaySession::enqueue(std::shared_ptr<const std::string> frame) {
+  if (m_closing || !m_open) {
+    return;
+  }
+
+  if (m_queue.size() >= m_relay.options().max_queue) {
+    if (m_relay.options().policy == SlowConsumerPolicy::disconnect) {
+      m_relay.m_disconnected++;
+      shutdown();
+      return;
+    }
+    m_queue.pop_front();
+    m_relay.m_dropped++;
+  }
+
+  m_queue.push_back(std::move(frame));
+  m_signal.cancel();
+}
+
+void RelaySession::shutdown() {
+  m_closing = true;
+  m_signal.cancel();
+  beast::error_code ec;
+  m_ws.next_layer().close(ec);
+}
+
+asio::awaitable<void> RelaySession::read_loop() {
+  // Subscribers only send control frames, reading keeps ping/pong and close handling alive
+  beast::flat_buffer buffer;
+  while (!m_closing) {
+    auto [ec, n] = co_await m_ws.async_read(buffer, asio::as_tuple(asio::use_awaitable));
+    if (ec) {
+      break;
+    }
+    buffer.consume(n);
+  }
+  shutdown();
+}
+
+asio::awaitable<void> RelaySession::write_loop() {
+  while (!m_closing) {
+    if (m_queue.empty()) {
+      m_signal.expires_at(asio::steady_timer::time_point::max());
+      co_await m_signal.async_wait(asio::as_tuple(asio::use_awaitable));
+      continue;
+    }
+
+    auto frame = std::move(m_queue.front());
+    m_queue.pop_front();
+    auto [ec, n] = co_await m_ws.async_write(asio::buffer(*frame), asio::as_tuple(asio::use_awaitable));
+    if (ec) {
+      break;
+    }
+  }
+  shutdown();
+}
+
+WebSocketRelay::WebSocketRelay(asio::io_context &ctx, const std::string &upstream_uri, const tcp::endpoint &listen,
+                               RelayOptions options)
+    : m_ctx(ctx), m_upstream_uri(upstream_uri), m_options(options), m_acceptor(asio::make_strand(ctx), listen),
+      m_drained(m_acceptor.get_executor()) {}
+
+int WebSocketRelay::add_upstream_message(const std::string &msg) {
+  m_upstream_messages.push_back(msg);
+  return 0;
+}
+
+asio::awaitable<void> WebSocketRelay::run() {
+  // Run on the acceptor's strand whatever executor the caller uses, so stop() never races accept_loop
+  co_await asio::co_spawn(m_acceptor.get_executor(), serve(), asio::use_awaitable);
+}
+
+asio::awaitable<void> WebSocketRelay::serve() {
+  using namespace asio::experimental::awaitable_operators;
+  co_await (accept_loop() || upstream_loop());
+
+  // Detached sessions still reference the relay, wait for each to deregister before returning
+  stop();
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      if (m_sessions.empty()) {
+        break;
+      }
+    }
+    m_drained.expires_at(asio::steady_timer::time_point::max());
+    co_await m_drained.async_wait(asio::as_tuple(asio::use_awaitable));
+  }
+
+  if (m_upstream_error) {
+    std::rethrow_exception(m_upstream_error);
+  }
+}
+
+void WebSocketRelay::stop() {
+  if (m_stopped.exchange(true)) {
+    return;
+  }
+
+  asio::post(m_acceptor.get_executor(), [this]() {
+    beast::error_code ec;
+    m_acceptor.close(ec);
+  });
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto &session : m_sessions) {
+    session->close();
+  }
+}
+
+void WebSocketRelay::broadcast(std::shared_ptr<const std::string> frame) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (const auto &session : m_sessions) {
+    session->deliver(frame);
+  }
+}
+
+asio::awaitable<void> WebSocketRelay::accept_loop() {
+  while (!m_stopped) {
+    // Every subscriber gets its own strand so writes fan out across all io_context threads
+    auto [ec, socket] = co_await m_acceptor.async_accept(asio::make_strand(m_ctx), asio::as_tuple(asio::use_awaitable));
+    if (ec == asio::error::operation_aborted || !m_acceptor.is_open()) {
+      break;
+    }
+    if (ec) {
+      continue;
+    }
+
+    auto executor = socket.get_executor();
+    auto session = std::make_shared<RelaySession>(std::move(socket), *this);
+    add(session);
+    asio::co_spawn(executor, session->run(), asio::detached);
+  }
+}
+
+asio::awaitable<void> WebSocketRelay::upstream_loop() {
+  try {
+    WebSocket upstream(m_upstream_uri);
+    co_await upstream.connect();
+    for (const auto &msg : m_upstream_messages) {
+      co_await upstream.write(msg);
+    }
+
+    while (!m_stopped) {
+      broadcast(std::make_shared<const std::string>(co_await upstream.read()));
+    }
+  } catch (const boost::system::system_error &e) {
+    // Cancelled by operator|| after stop() closed the acceptor: a normal shutdown, not an upstream failure
+    if (!(m_stopped && e.code() == asio::error::operation_aborted)) {
+      m_upstream_error = std::current_exception();
+    }
+  } catch (const std::exception &) {
+    m_upstream_error = std::current_exception();
+  }
+  stop();
+}
+
+void WebSocketRelay::add(std::shared_ptr<RelaySession> session) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_stopped) {
+    // stop() already walked m_sessions, close this one too so serve() can drain
+    session->close();
+  }
+  m_sessions.insert(std::move(session));
+}
+
+void WebSocketRelay::remove(std::shared_ptr<RelaySession> session, bool was_open) {
+  // Erase on the acceptor's strand: serve() cannot observe an empty set and return while this is still running
+  asio::post(m_acceptor.get_executor(), [this, session = std::move(session), was_open]() {
+    if (was_open) {
+      m_subscribers--;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sessions.erase(session);
+    if (m_sessions.empty()) {
+      m_drained.cancel();
+    }
+  });
+}
+
+}  // namespace cpphttp
@@ -5,6 +5,10 @@
 #include <boost/url/parse.hpp>
 #include <boost/system.hpp>
 #include <boost/beast.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <cstring>
+#include <sstream>
+#include <variant>
 
 namespace cpphttp {
 
@@ -42,27 +46,109 @@ int HttpRequest::set_header(const std::map<std::string, std::string> &headers) {
   return 0;
 }
 
-asio::awaitable<std::string> HttpRequest::request() {
-  auto executor = co_await asio::this_coro::executor;
-  auto parsedURI = boost::urls::parse_uri(m_url);
+int HttpRequest::set_hedge_policy(std::shared_ptr<HedgePolicy> policy) {
+  m_hedge = std::move(policy);
+  return 0;
+}
+
+int HttpRequest::set_cache(std::shared_ptr<ResponseCache> cache) {
+  m_cache = std::move(cache);
+  return 0;
+}
+
+int HttpRequest::set_coalescer(std::shared_ptr<RequestCoalescer> coalescer) {
+  m_coalescer = std::move(coalescer);
+  return 0;
+}
+
+int HttpRequest::set_socket_options(const SocketOptions &options) {
+  m_socket_options = options;
+  return 0;
+}
+
+int HttpRequest::set_endpoint_group(std::shared_ptr<EndpointGroup> group) {
+  m_group = std::move(group);
+  return 0;
+}
+
+int HttpRequest::set_capture(std::shared_ptr<CaptureWriter> capture) {
+  m_capture = std::move(capture);
+  m_capture_id = m_capture ? m_capture->next_connection_id() : 0;
+  return 0;
+}
+
+int HttpRequest::set_replay(std::shared_ptr<CaptureReader> replay, uint32_t connection_id) {
+  m_replay = replay ? std::make_shared<CaptureCursor>(std::move(replay)) : nullptr;
+  m_replay_connection = connection_id;
+  return 0;
+}
+
+void HttpRequest::on_response(std::string_view body, std::chrono::system_clock::time_point received) {
+  if (m_capture) {
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(received.time_since_epoch()).count();
+    m_capture->append(CaptureKind::http, m_capture_id, timestamp, body);
+  }
+}
+
+std::string_view HttpRequest::replay_next(CaptureRecord *out) {
+  CaptureRecord record;
+  if (!m_replay->next(record, CaptureKind::http, m_replay_connection)) {
+    throw std::runtime_error("Capture exhausted");
+  }
+  if (out) {
+    *out = record;
+  }
+  return record.payload;
+}
+
+bool HttpRequest::is_safe() const { return m_method == "GET" || m_method == "HEAD" || m_method == "OPTIONS"; }
+
+bool HttpRequest::is_idempotent() const {
+  return m_method == "GET" || m_method == "HEAD" || m_method == "OPTIONS" || m_method == "PUT" ||
+         m_method == "DELETE";
+}
+
+SocketOptions HttpRequest::connect_options(const Target &target) const {
+  // With TLS the SYN only carries the ClientHello, which is safe to replay; a plain-text
+  // request in the SYN is not, so Fast Open is limited to idempotent methods there
+  auto options = m_socket_options;
+  if (options.fast_open && !target.is_ssl && !is_idempotent()) {
+    options.fast_open = false;
+  }
+  // TLS early data can be replayed by an attacker long after the fact, so only safe methods
+  // are sent in it (RFC 8470 section 4); PUT and DELETE wait for the handshake
+  if (!target.is_ssl || !is_safe()) {
+    options.early_data = false;
+  }
+  return options;
+}
+
+HttpRequest::Target HttpRequest::parse_target(const std::string &url) {
+  auto parsedURI = boost::urls::parse_uri(url);
 
   if (parsedURI.has_error()) {
     throw std::runtime_error(parsedURI.error().message());
   }
 
-  std::string host = parsedURI->host();
-  bool is_ssl = (parsedURI->scheme() == "https");
-  
-  int port = parsedURI->port_number();
-  if (port == 0) {
-    port = is_ssl ? 443 : 80;
+  Target target;
+  target.host = parsedURI->host();
+  target.is_ssl = (parsedURI->scheme() == "https");
+
+  target.port = parsedURI->port_number();
+  if (target.port == 0) {
+    target.port = target.is_ssl ? 443 : 80;
   }
+  return target;
+}
+
+http::request<http::string_body> HttpRequest::build_request(const Target &target) const {
+  auto parsedURI = boost::urls::parse_uri(m_url);
   std::string path = std::string(parsedURI->encoded_path().data());
 
   http::request<http::string_body> req{http::verb::get, path, 11};
 
   // Set Headers
-  req.set(http::field::host, host); // Set the host header
+  req.set(http::field::host, target.host); // Set the host header
   req.set(http::field::user_agent, UA); // Set the user agent
   for (const auto& iter : m_headers) {
     req.set(iter.first, iter.second); // Set custom headers
@@ -77,14 +163,273 @@ asio::awaitable<std::string> HttpRequest::request() {
   } else {
     req.method(http::verb::get); // Default to GET
   }
+  return req;
+}
 
-  if (is_ssl) {
-    auto socket = co_await ConnectSSL(host, port)();
-    co_return co_await do_request(std::move(socket), req);
+asio::awaitable<std::string> HttpRequest::request() {
+  if (m_replay) {
+    co_return std::string(replay_next());
+  }
+  if (m_cache || m_coalescer) {
+    co_return *co_await request_shared();
+  }
+
+  auto target = parse_target(m_url);
+  auto req = build_request(target);
+  auto res = co_await send<http::string_body>(target, req);
+  auto body = take_body(res);
+  on_response(body);
+  co_return body;
+}
+
+asio::awaitable<std::shared_ptr<const std::string>> HttpRequest::request_shared() {
+  if (m_replay) {
+    co_return std::make_shared<const std::string>(replay_next());
+  }
+
+  auto target = parse_target(m_url);
+  auto req = build_request(target);
+  std::shared_ptr<const std::string> body;
+  // PUT and DELETE are idempotent too, but make_key() leaves out the body, so only bodiless reads are merged
+  if (m_coalescer && (m_method == "GET" || m_method == "HEAD")) {
+    auto coalescer = m_coalescer;
+    auto key = coalescer->make_key(m_method, m_url, m_headers);
+    // Only called when we lead the flight, before run() first suspends
+    body = co_await coalescer->run(key, [this, &target, &req]() {
+      return fetch_detached(std::make_shared<HttpRequest>(*this), target, req);
+    });
   } else {
-    auto socket = co_await Connect(host, port)();
-    co_return co_await do_request(std::move(socket), req);
+    body = co_await fetch_shared(target, req);
   }
+  on_response(*body);
+  co_return body;
+}
+
+asio::awaitable<std::shared_ptr<const std::string>> HttpRequest::fetch_detached(std::shared_ptr<HttpRequest> self,
+                                                                                Target target,
+                                                                                http::request<http::string_body> req) {
+  co_return co_await self->fetch_shared(target, req);
+}
+
+asio::awaitable<std::shared_ptr<const std::string>> HttpRequest::fetch_shared(const Target &target,
+                                                                              http::request<http::string_body> &req) {
+  if (m_cache && m_method == "GET") {
+    co_return co_await cached_send(target, req);
+  }
+  auto res = co_await send<http::string_body>(target, req);
+  co_return std::make_shared<const std::string>(take_body(res));
+}
+
+asio::awaitable<PaddedBuffer> HttpRequest::request_padded() {
+  if (m_replay) {
+    auto payload = replay_next();
+    PaddedBuffer body;
+    std::memcpy(body.prepare(payload.size()).data(), payload.data(), payload.size());
+    body.commit(payload.size());
+    co_return body;
+  }
+
+  auto target = parse_target(m_url);
+  auto req = build_request(target);
+  auto res = co_await send<http::basic_dynamic_body<PaddedBuffer>>(target, req);
+  auto body = take_body(res);
+  on_response(body.view());
+  co_return body;
+}
+
+asio::awaitable<TimestampedMessage> HttpRequest::request_timestamped() {
+  TimestampedMessage msg;
+  if (m_replay) {
+    CaptureRecord record;
+    msg.payload = std::string(replay_next(&record));
+    msg.kernel_rx = std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(record.timestamp_ns)));
+    msg.dequeue = std::chrono::system_clock::now();
+    co_return msg;
+  }
+
+  auto target = parse_target(m_url);
+  auto req = build_request(target);
+  http::response<http::string_body> res;
+  if (target.is_ssl) {
+    ConnectSSL conn(target.host, target.port);
+    conn.set_socket_options(connect_options(target));
+    auto stream = co_await conn.connect_ssl_timestamped();
+    res = co_await do_timestamped_request(*stream, stream->next_layer(), req, msg);
+  } else {
+    Connect conn(target.host, target.port);
+    conn.set_socket_options(connect_options(target));
+    auto socket = co_await conn.connect_timestamped();
+    res = co_await do_timestamped_request(*socket, *socket, req, msg);
+  }
+
+  msg.payload = take_body(res);
+  on_response(msg.payload, msg.kernel_rx.time_since_epoch().count() ? msg.kernel_rx : msg.dequeue);
+  co_return msg;
+}
+
+asio::awaitable<std::shared_ptr<const std::string>> HttpRequest::cached_send(const Target &target,
+                                                                             http::request<http::string_body> &req) {
+  auto cache = m_cache;
+  auto key = cache->make_key(m_method, m_url, m_headers);
+  auto cached = cache->lookup(key);
+  if (cached && cached->fresh()) {
+    co_return cached->body;
+  }
+
+  if (cached) {
+    if (!cached->etag.empty()) {
+      req.set(http::field::if_none_match, cached->etag);
+    }
+    if (!cached->last_modified.empty()) {
+      req.set(http::field::if_modified_since, cached->last_modified);
+    }
+  }
+
+  auto res = co_await send<http::string_body>(target, req);
+  if (cached && res.result() == http::status::not_modified) {
+    cache->revalidated(key, res[http::field::cache_control]);
+    co_return cached->body;
+  }
+
+  auto body = std::make_shared<const std::string>(take_body(res));
+  cache->store(key, body, res[http::field::cache_control], res[http::field::etag], res[http::field::last_modified]);
+  co_return body;
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::send(const Target &target, const http::request<http::string_body> &req) {
+  if (m_hedge && is_idempotent()) {
+    co_return co_await hedged_fetch<Body>(target, req);
+  }
+  co_return co_await fetch<Body>(target, req, 0);
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::fetch(const Target &target, const http::request<http::string_body> &req,
+                                                         size_t endpoint_offset) {
+  if (!m_group) {
+    co_return co_await fetch_from<Body>(target, req, endpoint_offset);
+  }
+
+  // The hedge (offset 1) goes to the second-best endpoint instead of repeating the first
+  auto group = m_group;
+  auto index = group->select(endpoint_offset);
+  auto endpoint = parse_target(group->url(index));
+  auto routed = req;
+  routed.set(http::field::host, endpoint.host);
+
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  };
+  try {
+    // With a single endpoint the hedge still needs a different resolved address
+    auto res = co_await fetch_from<Body>(endpoint, routed, group->size() > 1 ? 0 : endpoint_offset);
+    group->record(index, elapsed(), res.result_int() < 500);
+    co_return res;
+  } catch (const boost::system::system_error &e) {
+    // A cancelled hedge loser says nothing about the endpoint's health
+    if (e.code() != asio::error::operation_aborted) {
+      group->record(index, elapsed(), false);
+    }
+    throw;
+  } catch (...) {
+    group->record(index, elapsed(), false);
+    throw;
+  }
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::fetch_from(const Target &target,
+                                                              const http::request<http::string_body> &req,
+                                                              size_t endpoint_offset) {
+  if (target.is_ssl) {
+    auto options = connect_options(target);
+    ConnectSSL conn(target.host, target.port);
+    conn.set_endpoint_offset(endpoint_offset);
+    conn.set_socket_options(options);
+    conn.set_endpoint_group(m_group);
+    if (options.early_data) {
+      std::ostringstream serialized;
+      serialized << req;
+      conn.set_early_data(serialized.str());
+    }
+    auto socket = co_await conn();
+    // Rejected early data is discarded by the server, so the request is sent again after the handshake
+    co_return co_await do_request<Body>(std::move(socket), req, conn.early_data_accepted());
+  } else {
+    Connect conn(target.host, target.port);
+    conn.set_endpoint_offset(endpoint_offset);
+    conn.set_socket_options(connect_options(target));
+    conn.set_endpoint_group(m_group);
+    auto socket = co_await conn();
+    co_return co_await do_request<Body>(std::move(socket), req);
+  }
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::timed_fetch(const Target &target,
+                                                               const http::request<http::string_body> &req,
+                                                               std::shared_ptr<HedgePolicy> policy) {
+  // Only the primary attempt is sampled, whether or not a hedge is sent, so delay() tracks primary latency
+  auto start = std::chrono::steady_clock::now();
+  auto elapsed = [&start]() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+  };
+  try {
+    auto res = co_await fetch<Body>(target, req, 0);
+    policy->record(elapsed());
+    co_return res;
+  } catch (const boost::system::system_error &e) {
+    // Cancelled because the hedge won: the primary would have taken at least this long
+    if (e.code() == asio::error::operation_aborted) {
+      policy->record(elapsed());
+    }
+    throw;
+  }
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::hedged_fetch(const Target &target,
+                                                                const http::request<http::string_body> &req) {
+  using namespace asio::experimental::awaitable_operators;
+
+  // Keep a reference so the policy outlives both attempts even if set_hedge_policy() is called meanwhile
+  auto policy = m_hedge;
+  if (!policy->try_acquire()) {
+    co_return co_await timed_fetch<Body>(target, req, policy);
+  }
+
+  bool fired = false;
+  std::variant<http::response<Body>, http::response<Body>> result;
+  try {
+    // The loser is cancelled through its cancellation slot once the other attempt succeeds
+    result = co_await (timed_fetch<Body>(target, req, policy) ||
+                       delayed_fetch<Body>(target, req, policy->delay(), &fired));
+  } catch (const asio::multiple_exceptions &e) {
+    std::rethrow_exception(e.first_exception());
+  }
+
+  if (!fired) {
+    policy->refund();
+  } else if (result.index() == 1) {
+    policy->on_hedge_win();
+  }
+  co_return std::move(result.index() == 0 ? std::get<0>(result) : std::get<1>(result));
+}
+
+template<typename Body>
+asio::awaitable<http::response<Body>> HttpRequest::delayed_fetch(const Target &target,
+                                                                 const http::request<http::string_body> &req,
+                                                                 std::chrono::microseconds delay, bool *fired) {
+  auto executor = co_await asio::this_coro::executor;
+  asio::steady_timer timer(executor, delay);
+  co_await timer.async_wait(asio::use_awaitable);
+
+  // Start from the second resolved address so the duplicate avoids the slow node when possible
+  *fired = true;
+  co_return co_await fetch<Body>(target, req, 1);
 }
 
 }  // namespace Common
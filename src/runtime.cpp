@@ -0,0 +1,37 @@
+#include "runtime.h"
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <cerrno>
+#include <system_error>
+
+namespace cpphttp {
+
+int pin_thread(int cpu) {
+  if (cpu < 0 || cpu >= CPU_SETSIZE) {
+    return EINVAL;
+  }
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+size_t run_busy_poll(asio::io_context &ctx, int cpu) {
+  if (cpu >= 0) {
+    // Busy polling on an unpinned thread burns a core the scheduler keeps moving, so do not carry on silently
+    if (int err = pin_thread(cpu)) {
+      throw std::system_error(err, std::generic_category(), "pin_thread");
+    }
+  }
+
+  size_t handlers = 0;
+  while (!ctx.stopped()) {
+    // poll() returns immediately when nothing is ready and marks the context stopped once it runs out of work
+    handlers += ctx.poll();
+  }
+  return handlers;
+}
+
+}  // namespace cpphttp
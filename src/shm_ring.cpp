@@ -0,0 +1,184 @@
+#include "shm_ring.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <bit>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace cpphttp {
+
+namespace {
+
+constexpr uint64_t kMagic = 0x474e4952505448ULL;  // "HTPRING"
+constexpr uint32_t kVersion = 1;
+constexpr uint32_t kPadFlag = 1;
+constexpr size_t kDataOffset = (sizeof(ShmRingHeader) + 63) & ~size_t(63);
+
+size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+}  // namespace
+
+ShmRingWriter::ShmRingWriter(const std::string &name, size_t capacity)
+    : m_name(name), m_capacity(std::bit_ceil(std::max(capacity, size_t(4096)))) {
+  // Resizing a segment that readers still map would make their accesses past the new end raise SIGBUS,
+  // so a restarted writer always starts from a fresh segment
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("shm_open failed: " + std::string(std::strerror(errno)));
+  }
+
+  m_map_size = kDataOffset + m_capacity;
+  if (ftruncate(fd, m_map_size) != 0) {
+    close(fd);
+    throw std::runtime_error("ftruncate failed: " + std::string(std::strerror(errno)));
+  }
+
+  void *addr = mmap(nullptr, m_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+  }
+
+  m_header = new (addr) ShmRingHeader{};
+  m_header->capacity = m_capacity;
+  m_header->version = kVersion;
+  m_header->reserve_pos.store(0, std::memory_order_relaxed);
+  m_header->write_pos.store(0, std::memory_order_relaxed);
+  m_data = static_cast<char *>(addr) + kDataOffset;
+  // Readers check the magic last, publish it once the rest of the header is in place
+  std::atomic_thread_fence(std::memory_order_release);
+  m_header->magic = kMagic;
+}
+
+ShmRingWriter::~ShmRingWriter() { munmap(m_header, m_map_size); }
+
+int ShmRingWriter::publish(std::string_view payload, int64_t timestamp_ns) {
+  size_t record_size = align8(sizeof(ShmRecordHeader) + payload.size());
+  if (payload.size() > UINT32_MAX || record_size > m_capacity / 2) {
+    // Burn the sequence number so readers see the gap
+    m_seq++;
+    m_dropped++;
+    return -1;
+  }
+
+  uint64_t pos = m_header->write_pos.load(std::memory_order_relaxed);
+  size_t offset = pos & (m_capacity - 1);
+  size_t remaining = m_capacity - offset;
+  size_t skip = remaining < record_size ? remaining : 0;
+  uint64_t end = pos + skip + record_size;
+
+  // Announce the overwritten range before touching it so readers can detect torn records
+  m_header->reserve_pos.store(end, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (skip >= sizeof(ShmRecordHeader)) {
+    ShmRecordHeader pad{static_cast<uint32_t>(skip - sizeof(ShmRecordHeader)), kPadFlag, 0, 0};
+    std::memcpy(m_data + offset, &pad, sizeof(pad));
+  }
+  offset = (pos + skip) & (m_capacity - 1);
+
+  ShmRecordHeader header{static_cast<uint32_t>(payload.size()), 0, ++m_seq, timestamp_ns};
+  std::memcpy(m_data + offset, &header, sizeof(header));
+  std::memcpy(m_data + offset + sizeof(header), payload.data(), payload.size());
+
+  m_header->write_pos.store(end, std::memory_order_release);
+  return 0;
+}
+
+int ShmRingWriter::unlink() { return shm_unlink(m_name.c_str()); }
+
+ShmRingReader::ShmRingReader(const std::string &name) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("shm_open failed: " + std::string(std::strerror(errno)));
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < kDataOffset) {
+    close(fd);
+    throw std::runtime_error("Invalid shared memory ring");
+  }
+
+  m_map_size = st.st_size;
+  void *addr = mmap(nullptr, m_map_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+  }
+
+  m_header = static_cast<const ShmRingHeader *>(addr);
+  m_capacity = m_header->capacity;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (m_header->magic != kMagic || m_header->version != kVersion || kDataOffset + m_capacity > m_map_size) {
+    munmap(addr, m_map_size);
+    throw std::runtime_error("Invalid shared memory ring");
+  }
+
+  m_data = static_cast<const char *>(addr) + kDataOffset;
+  seek_latest();
+}
+
+ShmRingReader::~ShmRingReader() { munmap(const_cast<ShmRingHeader *>(m_header), m_map_size); }
+
+void ShmRingReader::seek_latest() { m_pos = m_header->write_pos.load(std::memory_order_acquire); }
+
+ShmReadResult ShmRingReader::read(ShmMessage &msg) {
+  while (true) {
+    uint64_t write_pos = m_header->write_pos.load(std::memory_order_acquire);
+    if (m_pos == write_pos) {
+      return ShmReadResult::empty;
+    }
+    if (write_pos - m_pos > m_capacity) {
+      return overrun();
+    }
+
+    size_t offset = m_pos & (m_capacity - 1);
+    size_t remaining = m_capacity - offset;
+    if (remaining < sizeof(ShmRecordHeader)) {
+      m_pos += remaining;
+      continue;
+    }
+
+    ShmRecordHeader header;
+    std::memcpy(&header, m_data + offset, sizeof(header));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_header->reserve_pos.load(std::memory_order_relaxed) > m_pos + m_capacity) {
+      return overrun();
+    }
+
+    if (header.flags & kPadFlag) {
+      m_pos += remaining;
+      continue;
+    }
+
+    msg.payload = std::string_view(m_data + offset + sizeof(header), header.size);
+    msg.seq = header.seq;
+    msg.timestamp_ns = header.timestamp_ns;
+    msg.position = m_pos;
+    m_pos += align8(sizeof(header) + header.size);
+    if (m_next_seq && header.seq > m_next_seq) {
+      m_lost += header.seq - m_next_seq;
+    }
+    m_next_seq = header.seq + 1;
+    return ShmReadResult::ok;
+  }
+}
+
+bool ShmRingReader::valid(const ShmMessage &msg) const {
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return m_header->reserve_pos.load(std::memory_order_relaxed) <= msg.position + m_capacity;
+}
+
+ShmReadResult ShmRingReader::overrun() {
+  m_overruns++;
+  seek_latest();
+  return ShmReadResult::overrun;
+}
+
+}  // namespace cpphttp
@@ -0,0 +1,165 @@
+#include "simd.h"
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CPPHTTP_SIMD_X86 1
+#endif
+
+namespace cpphttp {
+
+namespace scalar {
+
+namespace {
+
+// Validates one code point starting at data[i], returns its length or 0 when invalid
+size_t decode(const uint8_t *data, size_t size, size_t i) {
+  uint8_t c = data[i];
+  if (c < 0x80) {
+    return 1;
+  }
+
+  size_t len;
+  uint8_t min = 0x80, max = 0xbf;
+  if (c >= 0xc2 && c <= 0xdf) {
+    len = 2;
+  } else if (c >= 0xe0 && c <= 0xef) {
+    len = 3;
+    if (c == 0xe0) {
+      min = 0xa0;  // overlong
+    } else if (c == 0xed) {
+      max = 0x9f;  // surrogates
+    }
+  } else if (c >= 0xf0 && c <= 0xf4) {
+    len = 4;
+    if (c == 0xf0) {
+      min = 0x90;  // overlong
+    } else if (c == 0xf4) {
+      max = 0x8f;  // above U+10FFFF
+    }
+  } else {
+    return 0;
+  }
+
+  if (i + len > size || data[i + 1] < min || data[i + 1] > max) {
+    return 0;
+  }
+  for (size_t k = 2; k < len; k++) {
+    if ((data[i + k] & 0xc0) != 0x80) {
+      return 0;
+    }
+  }
+  return len;
+}
+
+}  // namespace
+
+bool validate_utf8(const char *data, size_t size) {
+  auto bytes = reinterpret_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size;) {
+    size_t len = decode(bytes, size, i);
+    if (len == 0) {
+      return false;
+    }
+    i += len;
+  }
+  return true;
+}
+
+}  // namespace scalar
+
+namespace {
+
+#ifdef CPPHTTP_SIMD_X86
+
+// Checks a run of non-ASCII bytes starting at data[i] and returns the index after it, or 0 when invalid.
+// With valid input such a run always holds complete multi-byte sequences, so it can be checked on its own.
+size_t validate_run(const char *data, size_t size, size_t i) {
+  auto bytes = reinterpret_cast<const uint8_t *>(data);
+  size_t end = i;
+  while (end < size && bytes[end] >= 0x80) {
+    end++;
+  }
+  return scalar::validate_utf8(data + i, end - i) ? end : 0;
+}
+
+// Each loop iteration starts on a code point boundary: ASCII is skipped a block at a time up to the first
+// byte with the high bit set, then the following non-ASCII run is validated
+__attribute__((target("avx2"))) bool validate_avx2(const char *data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    if (i + 32 <= size) {
+      auto high = static_cast<uint32_t>(
+          _mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i))));
+      if (high == 0) {
+        i += 32;
+        continue;
+      }
+      i += __builtin_ctz(high);
+    } else if (static_cast<uint8_t>(data[i]) < 0x80) {
+      i++;
+      continue;
+    }
+    i = validate_run(data, size, i);
+    if (i == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+__attribute__((target("sse2"))) bool validate_sse2(const char *data, size_t size) {
+  size_t i = 0;
+  while (i < size) {
+    if (i + 16 <= size) {
+      auto high = static_cast<uint32_t>(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i))));
+      if (high == 0) {
+        i += 16;
+        continue;
+      }
+      i += __builtin_ctz(high);
+    } else if (static_cast<uint8_t>(data[i]) < 0x80) {
+      i++;
+      continue;
+    }
+    i = validate_run(data, size, i);
+    if (i == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif
+
+struct Dispatch {
+  bool (*validate)(const char *, size_t);
+  const char *name;
+
+  Dispatch() : validate(scalar::validate_utf8), name("scalar") {
+#ifdef CPPHTTP_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+      validate = validate_avx2;
+      name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+      validate = validate_sse2;
+      name = "sse2";
+    }
+#endif
+  }
+};
+
+const Dispatch &dispatch() {
+  static const Dispatch instance;
+  return instance;
+}
+
+}  // namespace
+
+bool validate_utf8(const char *data, size_t size) { return dispatch().validate(data, size); }
+
+const char *simd_backend() { return dispatch().name; }
+
+}  // namespace cpphttp
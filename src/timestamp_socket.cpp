@@ -0,0 +1,83 @@
+#include "timestamp_socket.h"
+
+#include <time.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <sys/socket.h>
+
+#include <boost/beast/websocket/teardown.hpp>
+#include <cerrno>
+
+namespace cpphttp {
+
+namespace {
+
+std::chrono::system_clock::time_point to_time_point(int64_t ns) {
+  return std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(ns)));
+}
+
+}  // namespace
+
+TimestampSocket::TimestampSocket(asio::ip::tcp::socket socket) : m_socket(std::move(socket)) {
+  int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+  m_enabled = setsockopt(m_socket.native_handle(), SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == 0;
+}
+
+void TimestampSocket::mark() {
+  m_first_ns = 0;
+  m_mark_ns = m_last_ns;
+}
+
+std::chrono::system_clock::time_point TimestampSocket::first_rx() const {
+  return to_time_point(m_first_ns ? m_first_ns : m_mark_ns);
+}
+
+std::chrono::system_clock::time_point TimestampSocket::mark_rx() const { return to_time_point(m_mark_ns); }
+
+std::chrono::system_clock::time_point TimestampSocket::last_rx() const { return to_time_point(m_last_ns); }
+
+boost::system::error_code TimestampSocket::receive(iovec *iov, size_t count, std::size_t &n) {
+  n = 0;
+  if (count == 0) {
+    return {};
+  }
+
+  alignas(cmsghdr) char control[CMSG_SPACE(sizeof(scm_timestamping))];
+  msghdr msg{};
+  msg.msg_iov = iov;
+  msg.msg_iovlen = count;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t ret = ::recvmsg(m_socket.native_handle(), &msg, MSG_DONTWAIT);
+  if (ret < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return asio::error::would_block;
+    }
+    return boost::system::error_code(errno, boost::system::system_category());
+  }
+  if (ret == 0) {
+    return asio::error::eof;
+  }
+
+  for (cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_TIMESTAMPING) {
+      // ts[0] is the software timestamp, ts[2] the hardware one
+      auto *ts = reinterpret_cast<scm_timestamping *>(CMSG_DATA(cmsg));
+      m_last_ns = static_cast<int64_t>(ts->ts[0].tv_sec) * 1'000'000'000 + ts->ts[0].tv_nsec;
+      if (!m_first_ns) {
+        m_first_ns = m_last_ns;
+      }
+    }
+  }
+
+  n = static_cast<std::size_t>(ret);
+  return {};
+}
+
+void teardown(beast::role_type role, TimestampSocket &socket, boost::system::error_code &ec) {
+  beast::websocket::teardown(role, socket.next_layer(), ec);
+}
+
+}  // namespace cpphttp
@@ -0,0 +1,145 @@
+#include "tls_session.h"
+
+namespace cpphttp {
+
+namespace {
+
+// 挂在 SSL 对象上，TLS 1.3 的票据在握手完成后才到达，此时 Connect 可能已经析构
+struct SessionBinding {
+  std::weak_ptr<TlsSessionCache> cache;
+  std::string key;
+};
+
+void free_binding(void *, void *ptr, CRYPTO_EX_DATA *, int, long, void *) {
+  delete static_cast<SessionBinding *>(ptr);
+}
+
+int binding_index() {
+  static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, free_binding);
+  return index;
+}
+
+int on_new_session(SSL *ssl, SSL_SESSION *session) {
+  auto *binding = static_cast<SessionBinding *>(SSL_get_ex_data(ssl, binding_index()));
+  if (!binding || !SSL_SESSION_is_resumable(session)) {
+    return 0;
+  }
+  auto cache = binding->cache.lock();
+  if (!cache) {
+    return 0;
+  }
+  // Keep a copy: OpenSSL marks the connection's own session unresumable when the
+  // SSL object is freed without a close_notify, which is how most connections here end
+  auto *copy = SSL_SESSION_dup(session);
+  if (copy) {
+    cache->store(binding->key, copy);
+  }
+  return 0;
+}
+
+}  // namespace
+
+TlsSessionCache::~TlsSessionCache() {
+  for (auto &[key, sessions] : m_sessions) {
+    for (auto *session : sessions) {
+      SSL_SESSION_free(session);
+    }
+  }
+}
+
+void TlsSessionCache::enable(SSL_CTX *ctx) {
+  // 会话只保存在 TlsSessionCache 中，OpenSSL 的内部缓存对客户端没有用处
+  SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+  SSL_CTX_sess_set_new_cb(ctx, on_new_session);
+}
+
+bool TlsSessionCache::attach(SSL *ssl, const std::string &key) {
+  auto *binding = static_cast<SessionBinding *>(SSL_get_ex_data(ssl, binding_index()));
+  if (binding) {
+    *binding = SessionBinding{weak_from_this(), key};
+  } else {
+    SSL_set_ex_data(ssl, binding_index(), new SessionBinding{weak_from_this(), key});
+  }
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_sessions.find(key);
+  if (it == m_sessions.end()) {
+    return false;
+  }
+  auto &sessions = it->second;
+  while (!sessions.empty() && !SSL_SESSION_is_resumable(sessions.back())) {
+    SSL_SESSION_free(sessions.back());
+    sessions.pop_back();
+  }
+  if (sessions.empty()) {
+    m_sessions.erase(it);
+    return false;
+  }
+
+  auto *session = sessions.back();
+  bool attached = SSL_set_session(ssl, session) == 1;
+  // A reused TLS 1.3 ticket lets observers link connections, so each one is offered once;
+  // SSL_set_session holds its own reference
+  if (SSL_SESSION_get_protocol_version(session) >= TLS1_3_VERSION) {
+    SSL_SESSION_free(session);
+    sessions.pop_back();
+    if (sessions.empty()) {
+      m_sessions.erase(it);
+    }
+  }
+  return attached;
+}
+
+void TlsSessionCache::on_handshake(SSL *ssl, const std::string &key, bool success) {
+  if (!success) {
+    erase(key);
+    return;
+  }
+  if (SSL_session_reused(ssl)) {
+    m_resumed++;
+  } else {
+    m_full_handshakes++;
+  }
+}
+
+void TlsSessionCache::store(const std::string &key, SSL_SESSION *session) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto &sessions = m_sessions[key];
+  // TLS 1.2 resumes with one session, and tickets for another protocol version are stale;
+  // only TLS 1.3 tickets are worth keeping several of
+  auto version = SSL_SESSION_get_protocol_version(session);
+  if (!sessions.empty() &&
+      (version < TLS1_3_VERSION || SSL_SESSION_get_protocol_version(sessions.back()) != version)) {
+    for (auto *old : sessions) {
+      SSL_SESSION_free(old);
+    }
+    sessions.clear();
+  }
+  sessions.push_back(session);
+  if (sessions.size() > kMaxTickets) {
+    SSL_SESSION_free(sessions.front());
+    sessions.pop_front();
+  }
+}
+
+void TlsSessionCache::erase(const std::string &key) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_sessions.find(key);
+  if (it != m_sessions.end()) {
+    for (auto *session : it->second) {
+      SSL_SESSION_free(session);
+    }
+    m_sessions.erase(it);
+  }
+}
+
+size_t TlsSessionCache::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  size_t count = 0;
+  for (const auto &[key, sessions] : m_sessions) {
+    count += sessions.size();
+  }
+  return count;
+}
+
+}  // namespace cpphttp
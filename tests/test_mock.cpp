@@ -1,11 +1,33 @@
 #include <gtest/gtest.h>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
 #include <boost/asio/co_spawn.hpp>
 #include <boost/asio/detached.hpp>
 #include <boost/asio/io_context.hpp>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <optional>
+#include <thread>
 #include "request.h"
 #include "connect.h"
 #include "WebSocket.h"
+#include "hedge.h"
+#include "relay.h"
+#include "padded_buffer.h"
+#include "cache.h"
+#include "coalesce.h"
+#include "shm_ring.h"
+#include "capture.h"
+#include "timestamp_socket.h"
+#include "runtime.h"
+#include "simd.h"
+#include "tls_session.h"
+#include "endpoint_group.h"
 
 using namespace cpphttp;
 
@@ -183,3 +205,1261 @@ TEST(CoroutineTest, BasicCoroutineTest) {
     // 测试应该正常完成
     SUCCEED();
 }
+
+// 测试对冲策略：样本不足时使用默认延迟，样本足够后使用分位数
+TEST(HedgePolicyTest, DelayTest) {
+    HedgePolicy policy(std::chrono::milliseconds(50), 0.1, 0.95);
+    EXPECT_EQ(std::chrono::microseconds(50000), policy.delay());
+
+    for (int i = 1; i <= 100; i++) {
+        policy.record(std::chrono::microseconds(i * 1000));
+    }
+    EXPECT_EQ(std::chrono::microseconds(95000), policy.delay());
+}
+
+// 测试对冲预算：令牌耗尽后不再对冲，退还后可以再次对冲
+TEST(HedgePolicyTest, BudgetTest) {
+    HedgePolicy policy(std::chrono::milliseconds(50), 0.0);
+    EXPECT_TRUE(policy.try_acquire());
+    EXPECT_FALSE(policy.try_acquire());
+    EXPECT_EQ(1u, policy.hedges_sent());
+
+    policy.refund();
+    EXPECT_EQ(0u, policy.hedges_sent());
+    EXPECT_TRUE(policy.try_acquire());
+}
+
+namespace {
+
+namespace http = boost::beast::http;
+using tcp = boost::asio::ip::tcp;
+
+// 本地回环 HTTP 服务器：第 index 个连接读一个请求，交给 handler 生成响应
+// handler 可以直接操作 socket，例如等待客户端关闭连接而不返回响应
+using HttpHandler = std::function<boost::asio::awaitable<std::optional<http::response<http::string_body>>>(
+    size_t index, const http::request<http::string_body> &req, tcp::socket &socket)>;
+
+boost::asio::awaitable<void> serve_connection(tcp::socket socket, size_t index, HttpHandler handler) {
+    boost::beast::flat_buffer buffer;
+    http::request<http::string_body> req;
+    co_await http::async_read(socket, buffer, req, boost::asio::use_awaitable);
+    auto res = co_await handler(index, req, socket);
+    if (res) {
+        res->prepare_payload();
+        co_await http::async_write(socket, *res, boost::asio::use_awaitable);
+    }
+}
+
+boost::asio::awaitable<void> serve_http(tcp::acceptor &acceptor, size_t connections, HttpHandler handler) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    for (size_t i = 0; i < connections; i++) {
+        auto socket = co_await acceptor.async_accept(boost::asio::use_awaitable);
+        boost::asio::co_spawn(executor, serve_connection(std::move(socket), i, handler), boost::asio::detached);
+    }
+}
+
+http::response<http::string_body> make_response(const std::string &body, http::status status = http::status::ok) {
+    http::response<http::string_body> res{status, 11};
+    res.body() = body;
+    return res;
+}
+
+std::string loopback_url(const tcp::acceptor &acceptor, const std::string &path) {
+    return "http://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + path;
+}
+
+}  // namespace
+
+// 测试对冲竞速：主请求卡住时对冲请求胜出，主请求被取消并关闭连接
+TEST(HttpRequestTest, HedgeRaceTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto policy = std::make_shared<HedgePolicy>(std::chrono::milliseconds(20), 0.0);
+    bool primary_closed = false;
+    std::string body;
+
+    auto handler = [&](size_t index, const http::request<http::string_body> &, tcp::socket &socket)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        if (index == 0) {
+            // 主请求不响应，只等待客户端取消后关闭连接
+            co_await socket.async_wait(tcp::socket::wait_read, boost::asio::use_awaitable);
+            primary_closed = true;
+            co_return std::nullopt;
+        }
+        co_return make_response("hedge");
+    };
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        HttpRequest request(loopback_url(acceptor, "/depth"), "GET");
+        request.set_hedge_policy(policy);
+        body = co_await request.request();
+    };
+
+    boost::asio::co_spawn(io_context, serve_http(acceptor, 2, handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ("hedge", body);
+    EXPECT_EQ(1u, policy->hedges_sent());
+    EXPECT_EQ(1u, policy->hedges_won());
+    EXPECT_TRUE(primary_closed);
+}
+
+// 测试主请求在对冲延迟内返回时退还预算，预算耗尽时主请求的延迟仍被采样
+TEST(HttpRequestTest, HedgeRefundAndSamplingTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto refunded = std::make_shared<HedgePolicy>(std::chrono::seconds(1), 0.0);
+    auto exhausted = std::make_shared<HedgePolicy>(std::chrono::seconds(1), 0.0);
+    ASSERT_TRUE(exhausted->try_acquire());
+    const int requests = 20;
+    int completed = 0;
+
+    auto handler = [&](size_t, const http::request<http::string_body> &, tcp::socket &)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        co_return make_response("ok");
+    };
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        HttpRequest request(loopback_url(acceptor, "/ticker"), "GET");
+        request.set_hedge_policy(refunded);
+        auto first = co_await request.request();
+        EXPECT_EQ("ok", first);
+
+        request.set_hedge_policy(exhausted);
+        for (int i = 0; i < requests; i++) {
+            auto body = co_await request.request();
+            EXPECT_EQ("ok", body);
+            completed++;
+        }
+    };
+
+    boost::asio::co_spawn(io_context, serve_http(acceptor, requests + 1, handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ(0u, refunded->hedges_sent());
+    EXPECT_EQ(requests, completed);
+    EXPECT_EQ(1u, exhausted->hedges_sent());
+    // 20 个主请求的样本足够后，延迟取本地回环的分位数而不是 1 秒的默认值
+    EXPECT_LT(exhausted->delay(), std::chrono::microseconds(std::chrono::seconds(1)));
+}
+
+// 测试对冲策略设置
+TEST(HttpRequestTest, HedgePolicySettingTest) {
+    HttpRequest request("http://example.com/api", "GET");
+    EXPECT_EQ(0, request.set_hedge_policy(std::make_shared<HedgePolicy>()));
+    EXPECT_EQ(0, request.set_hedge_policy(nullptr));
+}
+
+// 测试转发服务构造，不连接上游
+TEST(WebSocketRelayTest, ConstructTest) {
+    boost::asio::io_context io_context;
+    RelayOptions options;
+    options.max_queue = 16;
+    options.policy = SlowConsumerPolicy::disconnect;
+
+    WebSocketRelay relay(io_context, "ws://127.0.0.1:9/feed",
+                         boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0), options);
+    EXPECT_EQ(0, relay.add_upstream_message(R"({"op": "subscribe"})"));
+    EXPECT_EQ(0u, relay.subscriber_count());
+    EXPECT_EQ(16u, relay.options().max_queue);
+
+    // 没有订阅者时广播不应出错
+    relay.broadcast(std::make_shared<const std::string>("frame"));
+    EXPECT_EQ(0u, relay.dropped_frames());
+    relay.stop();
+    io_context.run();
+}
+
+namespace {
+
+// 本地回环 WebSocket 上游：接受一个连接并读取订阅消息，ready() 为真后依次发送 frames，然后等待对端关闭
+boost::asio::awaitable<void> serve_upstream(tcp::acceptor &acceptor, std::vector<std::string> frames,
+                                            std::function<bool()> ready) {
+    auto executor = co_await boost::asio::this_coro::executor;
+    boost::beast::websocket::stream<tcp::socket> ws(co_await acceptor.async_accept(boost::asio::use_awaitable));
+    co_await ws.async_accept(boost::asio::use_awaitable);
+    boost::beast::flat_buffer buffer;
+    co_await ws.async_read(buffer, boost::asio::use_awaitable);
+
+    boost::asio::steady_timer timer(executor);
+    while (!ready()) {
+        timer.expires_after(std::chrono::milliseconds(5));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+    for (const auto &frame : frames) {
+        co_await ws.async_write(boost::asio::buffer(frame), boost::asio::use_awaitable);
+    }
+    co_await ws.async_read(buffer, boost::asio::use_awaitable);
+}
+
+boost::asio::awaitable<std::unique_ptr<boost::beast::websocket::stream<tcp::socket>>> connect_subscriber(
+    const tcp::endpoint &endpoint) {
+    auto ws = std::make_unique<boost::beast::websocket::stream<tcp::socket>>(co_await boost::asio::this_coro::executor);
+    co_await ws->next_layer().async_connect(endpoint, boost::asio::use_awaitable);
+    co_await ws->async_handshake("127.0.0.1", "/", boost::asio::use_awaitable);
+    co_return ws;
+}
+
+boost::asio::awaitable<void> wait_until(std::function<bool()> condition) {
+    boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor);
+    while (!condition()) {
+        timer.expires_after(std::chrono::milliseconds(5));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+    }
+}
+
+std::string upstream_uri(const tcp::acceptor &acceptor) {
+    return "ws://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/feed";
+}
+
+// 一个不读取数据的订阅者连接后广播大量帧，返回 relay 丢弃的帧数和断开的订阅者数
+std::pair<uint64_t, uint64_t> run_slow_consumer(SlowConsumerPolicy policy) {
+    boost::asio::io_context io_context;
+    tcp::acceptor upstream(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    RelayOptions options;
+    options.max_queue = 4;
+    options.policy = policy;
+    WebSocketRelay relay(io_context, upstream_uri(upstream),
+                         tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0), options);
+    std::exception_ptr run_error;
+
+    auto test = [&]() -> boost::asio::awaitable<void> {
+        auto ws = co_await connect_subscriber(relay.local_endpoint());
+        co_await wait_until([&]() { return relay.subscriber_count() == 1; });
+
+        auto frame = std::make_shared<const std::string>(256 * 1024, 'x');
+        for (int i = 0; i < 128; i++) {
+            relay.broadcast(frame);
+        }
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(200));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        relay.stop();
+    };
+
+    boost::asio::co_spawn(io_context, serve_upstream(upstream, {}, []() { return true; }), boost::asio::detached);
+    boost::asio::co_spawn(io_context, relay.run(), [&](std::exception_ptr e) { run_error = e; });
+    boost::asio::co_spawn(io_context, test(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(10));
+
+    EXPECT_FALSE(run_error);
+    return {relay.dropped_frames(), relay.disconnected_subscribers()};
+}
+
+}  // namespace
+
+// 测试转发：两个订阅者收到同样的上游帧，stop() 后 run() 正常返回
+TEST(WebSocketRelayTest, FanOutTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor upstream(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    WebSocketRelay relay(io_context, upstream_uri(upstream),
+                         tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 0));
+    relay.add_upstream_message(R"({"op": "subscribe"})");
+    const std::vector<std::string> frames = {"trade 1", "trade 2", "trade 3"};
+    std::vector<std::vector<std::string>> received(2);
+    int finished = 0;
+    bool run_returned = false;
+    std::exception_ptr run_error;
+
+    auto subscriber = [&](size_t index) -> boost::asio::awaitable<void> {
+        auto ws = co_await connect_subscriber(relay.local_endpoint());
+        boost::beast::flat_buffer buffer;
+        while (received[index].size() < frames.size()) {
+            co_await ws->async_read(buffer, boost::asio::use_awaitable);
+            received[index].push_back(boost::beast::buffers_to_string(buffer.data()));
+            buffer.consume(buffer.size());
+        }
+        if (++finished == 2) {
+            relay.stop();
+        }
+    };
+
+    boost::asio::co_spawn(io_context, serve_upstream(upstream, frames, [&]() { return relay.subscriber_count() == 2; }),
+                          boost::asio::detached);
+    boost::asio::co_spawn(io_context, relay.run(), [&](std::exception_ptr e) {
+        run_error = e;
+        run_returned = true;
+    });
+    boost::asio::co_spawn(io_context, subscriber(0), boost::asio::detached);
+    boost::asio::co_spawn(io_context, subscriber(1), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(10));
+
+    EXPECT_EQ(frames, received[0]);
+    EXPECT_EQ(frames, received[1]);
+    EXPECT_TRUE(run_returned);
+    EXPECT_FALSE(run_error);
+    EXPECT_EQ(0u, relay.subscriber_count());
+}
+
+// 测试慢订阅者：写队列超过 max_queue 后丢弃最旧的帧
+TEST(WebSocketRelayTest, DropOldestTest) {
+    auto [dropped, disconnected] = run_slow_consumer(SlowConsumerPolicy::drop_oldest);
+    EXPECT_GT(dropped, 0u);
+    EXPECT_EQ(0u, disconnected);
+}
+
+// 测试慢订阅者：写队列超过 max_queue 后断开连接
+TEST(WebSocketRelayTest, DisconnectTest) {
+    auto [dropped, disconnected] = run_slow_consumer(SlowConsumerPolicy::disconnect);
+    EXPECT_EQ(0u, dropped);
+    EXPECT_EQ(1u, disconnected);
+}
+
+// 测试带填充缓冲区：按 DynamicBuffer 方式写入后，数据之后始终有清零的填充
+TEST(PaddedBufferTest, DynamicBufferTest) {
+    PaddedBuffer buffer;
+    for (int i = 0; i < 100; i++) {
+        auto mb = buffer.prepare(10);
+        std::memcpy(mb.data(), "0123456789", 10);
+        buffer.commit(10);
+    }
+    EXPECT_EQ(1000u, buffer.size());
+    EXPECT_GE(buffer.padded_size(), buffer.size() + PaddedBuffer::kPadding);
+
+    buffer.consume(995);
+    EXPECT_EQ("56789", buffer.view());
+    for (size_t i = 0; i < PaddedBuffer::kPadding; i++) {
+        EXPECT_EQ(0, buffer.bytes()[buffer.size() + i]);
+    }
+
+    PaddedBuffer copy = buffer;
+    EXPECT_EQ(buffer.view(), copy.view());
+    PaddedBuffer moved = std::move(copy);
+    EXPECT_EQ("56789", moved.str());
+
+    // 没有分配过的缓冲区（例如空响应体）也带有填充
+    PaddedBuffer empty;
+    EXPECT_EQ(0u, empty.size());
+    EXPECT_EQ(PaddedBuffer::kPadding, empty.padded_size());
+    EXPECT_EQ(0, empty.bytes()[0]);
+}
+
+// 测试 HTTP 响应体经 Beast 直接读入填充缓冲区，包括空响应体
+TEST(PaddedBufferTest, HttpRequestTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    const std::string payload = R"({"bids": [["42000.5", "1.25"]], "asks": []})";
+    std::vector<PaddedBuffer> bodies;
+
+    auto handler = [&](size_t index, const http::request<http::string_body> &, tcp::socket &)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        co_return make_response(index == 0 ? payload : "");
+    };
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        HttpRequest request(loopback_url(acceptor, "/depth"), "GET");
+        bodies.push_back(co_await request.request_padded());
+        bodies.push_back(co_await request.request_padded());
+    };
+
+    boost::asio::co_spawn(io_context, serve_http(acceptor, 2, handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    ASSERT_EQ(2u, bodies.size());
+    EXPECT_EQ(payload, bodies[0].view());
+    EXPECT_GE(bodies[0].padded_size(), payload.size() + PaddedBuffer::kPadding);
+    for (size_t i = 0; i < PaddedBuffer::kPadding; i++) {
+        EXPECT_EQ(0, bodies[0].bytes()[payload.size() + i]);
+    }
+    EXPECT_EQ(0u, bodies[1].size());
+    EXPECT_GE(bodies[1].padded_size(), PaddedBuffer::kPadding);
+}
+
+// 测试 WebSocket 消息经 Beast 直接读入填充缓冲区
+TEST(PaddedBufferTest, WebSocketTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor upstream(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    const std::vector<std::string> frames = {R"({"e": "trade", "p": "42000.5"})", std::string(4096, 'x')};
+    std::vector<PaddedBuffer> messages;
+
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        WebSocket ws(upstream_uri(upstream));
+        co_await ws.connect();
+        co_await ws.write(R"({"op": "subscribe"})");
+        for (size_t i = 0; i < frames.size(); i++) {
+            messages.push_back(co_await ws.read_padded());
+        }
+        co_await ws.close();
+    };
+
+    boost::asio::co_spawn(io_context, serve_upstream(upstream, frames, []() { return true; }), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    ASSERT_EQ(frames.size(), messages.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        EXPECT_EQ(frames[i], messages[i].view());
+        EXPECT_GE(messages[i].padded_size(), frames[i].size() + PaddedBuffer::kPadding);
+        EXPECT_EQ(0, messages[i].bytes()[frames[i].size()]);
+    }
+}
+
+// 测试 Cache-Control 解析
+TEST(ResponseCacheTest, CacheControlParseTest) {
+    auto cc = CacheControl::parse("public, max-age=60, no-cache");
+    EXPECT_TRUE(cc.no_cache);
+    EXPECT_FALSE(cc.no_store);
+    ASSERT_TRUE(cc.max_age.has_value());
+    EXPECT_EQ(60, cc.max_age->count());
+
+    EXPECT_TRUE(CacheControl::parse("No-Store").no_store);
+    EXPECT_FALSE(CacheControl::parse("max-age=abc").max_age.has_value());
+}
+
+// 测试缓存命中、重新验证和计数
+TEST(ResponseCacheTest, LookupAndRevalidateTest) {
+    ResponseCache cache;
+    EXPECT_FALSE(cache.lookup("http://example.com/a").has_value());
+
+    cache.store("http://example.com/a", std::make_shared<const std::string>("body"), "max-age=60", "\"v1\"", "");
+    auto fresh = cache.lookup("http://example.com/a");
+    ASSERT_TRUE(fresh.has_value());
+    EXPECT_TRUE(fresh->fresh());
+    EXPECT_EQ("body", *fresh->body);
+
+    // 过期但带 ETag 的条目仍保留，用于条件请求
+    cache.store("http://example.com/b", std::make_shared<const std::string>("old"), "no-cache", "\"v2\"", "");
+    auto stale = cache.lookup("http://example.com/b");
+    ASSERT_TRUE(stale.has_value());
+    EXPECT_FALSE(stale->fresh());
+    EXPECT_EQ("\"v2\"", stale->etag);
+
+    cache.revalidated("http://example.com/b", "max-age=30");
+    EXPECT_TRUE(cache.lookup("http://example.com/b")->fresh());
+
+    // no-store 和既无有效期又无验证器的响应不缓存
+    cache.store("http://example.com/c", std::make_shared<const std::string>("x"), "no-store", "\"v3\"", "");
+    cache.store("http://example.com/d", std::make_shared<const std::string>("x"), "", "", "");
+    EXPECT_FALSE(cache.lookup("http://example.com/c").has_value());
+    EXPECT_FALSE(cache.lookup("http://example.com/d").has_value());
+
+    EXPECT_EQ(2u, cache.hits());
+    EXPECT_EQ(4u, cache.misses());
+    EXPECT_EQ(1u, cache.revalidations());
+}
+
+// 测试按字节数淘汰最久未使用的条目
+TEST(ResponseCacheTest, LruEvictionTest) {
+    ResponseCache cache(50);
+    cache.store("a", std::make_shared<const std::string>(20, 'a'), "max-age=60", "", "");
+    cache.store("b", std::make_shared<const std::string>(20, 'b'), "max-age=60", "", "");
+    cache.lookup("a");
+    cache.store("c", std::make_shared<const std::string>(20, 'c'), "max-age=60", "", "");
+
+    EXPECT_TRUE(cache.lookup("a").has_value());
+    EXPECT_FALSE(cache.lookup("b").has_value());
+    EXPECT_TRUE(cache.lookup("c").has_value());
+    EXPECT_LE(cache.size_bytes(), 50u);
+}
+
+// 测试缓存 key 包含请求头，忽略列表中的头部不参与计算
+TEST(ResponseCacheTest, KeyTest) {
+    ResponseCache cache(1024, {"X-Request-ID"});
+    auto key1 = cache.make_key("GET", "http://example.com/a", {{"Authorization", "t1"}, {"X-Request-ID", "1"}});
+    auto key2 = cache.make_key("GET", "http://example.com/a", {{"authorization", "t1"}, {"x-request-id", "2"}});
+    auto key3 = cache.make_key("GET", "http://example.com/a", {{"Authorization", "t2"}});
+    auto key4 = cache.make_key("GET", "http://example.com/a", {{"Authorization", "t1"}, {"Accept", "text/csv"}});
+    EXPECT_EQ(key1, key2);
+    EXPECT_NE(key1, key3);
+    EXPECT_NE(key1, key4);
+}
+
+// 测试 HttpRequest 通过缓存发送条件请求：304 返回缓存的响应体，不同凭证的请求不共享缓存
+TEST(ResponseCacheTest, RevalidateRequestTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto cache = std::make_shared<ResponseCache>();
+    std::vector<std::string> if_none_match;
+    std::vector<std::string> bodies;
+
+    auto handler = [&](size_t, const http::request<http::string_body> &req, tcp::socket &)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        if_none_match.push_back(std::string(req[http::field::if_none_match]));
+        if (req[http::field::if_none_match] == "\"v1\"") {
+            co_return make_response("", http::status::not_modified);
+        }
+        auto res = make_response("body for " + std::string(req[http::field::authorization]));
+        res.set(http::field::etag, "\"v1\"");
+        res.set(http::field::cache_control, "no-cache");
+        co_return res;
+    };
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        HttpRequest alice(loopback_url(acceptor, "/account"), "GET");
+        alice.set_header("Authorization", "alice");
+        alice.set_cache(cache);
+        bodies.push_back(co_await alice.request());
+        bodies.push_back(co_await alice.request());
+
+        HttpRequest bob(loopback_url(acceptor, "/account"), "GET");
+        bob.set_header("Authorization", "bob");
+        bob.set_cache(cache);
+        bodies.push_back(co_await bob.request());
+    };
+
+    boost::asio::co_spawn(io_context, serve_http(acceptor, 3, handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ((std::vector<std::string>{"body for alice", "body for alice", "body for bob"}), bodies);
+    EXPECT_EQ((std::vector<std::string>{"", "\"v1\"", ""}), if_none_match);
+    EXPECT_EQ(1u, cache->revalidations());
+    EXPECT_EQ(2u, cache->entries());
+}
+
+// 测试合并 key 默认包含所有请求头，不同凭证的请求不会被合并，忽略列表中的头部不参与计算
+TEST(RequestCoalescerTest, KeyTest) {
+    RequestCoalescer by_default;
+    EXPECT_NE(by_default.make_key("GET", "http://example.com/a", {{"Authorization", "t1"}}),
+              by_default.make_key("GET", "http://example.com/a", {{"Authorization", "t2"}}));
+    EXPECT_NE(by_default.make_key("GET", "http://example.com/a", {{"X-MBX-APIKEY", "k1"}}),
+              by_default.make_key("GET", "http://example.com/a", {}));
+
+    RequestCoalescer coalescer({"X-Request-ID"});
+    auto key1 = coalescer.make_key("GET", "http://example.com/a", {{"authorization", "t1"}, {"X-Request-ID", "1"}});
+    auto key2 = coalescer.make_key("GET", "http://example.com/a", {{"Authorization", "t1"}, {"x-request-id", "2"}});
+    auto key3 = coalescer.make_key("GET", "http://example.com/a", {{"Authorization", "t2"}});
+    EXPECT_EQ(key1, key2);
+    EXPECT_NE(key1, key3);
+}
+
+// 测试并发的相同请求只执行一次，所有等待者拿到同一份响应
+TEST(RequestCoalescerTest, SingleFlightTest) {
+    boost::asio::io_context io_context;
+    RequestCoalescer coalescer;
+    int calls = 0;
+    std::vector<RequestCoalescer::Response> responses;
+
+    auto fetch = [&]() -> boost::asio::awaitable<RequestCoalescer::Response> {
+        calls++;
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(10));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_return std::make_shared<const std::string>("snapshot");
+    };
+    auto waiter = [&]() -> boost::asio::awaitable<void> {
+        responses.push_back(co_await coalescer.run("GET http://example.com/depth", fetch));
+    };
+
+    for (int i = 0; i < 3; i++) {
+        boost::asio::co_spawn(io_context, waiter(), boost::asio::detached);
+    }
+    io_context.run();
+
+    EXPECT_EQ(1, calls);
+    ASSERT_EQ(3u, responses.size());
+    EXPECT_EQ(responses[0].get(), responses[1].get());
+    EXPECT_EQ(responses[0].get(), responses[2].get());
+    EXPECT_EQ(2u, coalescer.coalesced());
+    EXPECT_EQ(0u, coalescer.in_flight());
+}
+
+// 测试失败会传递给每个等待者
+TEST(RequestCoalescerTest, ErrorPropagationTest) {
+    boost::asio::io_context io_context;
+    RequestCoalescer coalescer;
+    int failures = 0;
+
+    auto fetch = [&]() -> boost::asio::awaitable<RequestCoalescer::Response> {
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(10));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        throw std::runtime_error("upstream failed");
+    };
+    auto waiter = [&]() -> boost::asio::awaitable<void> {
+        try {
+            co_await coalescer.run("GET http://example.com/depth", fetch);
+        } catch (const std::runtime_error &e) {
+            failures++;
+        }
+    };
+
+    boost::asio::co_spawn(io_context, waiter(), boost::asio::detached);
+    boost::asio::co_spawn(io_context, waiter(), boost::asio::detached);
+    io_context.run();
+    EXPECT_EQ(2, failures);
+}
+
+// 测试取消第一个调用者不影响其他等待者，请求完成后条目被移除
+TEST(RequestCoalescerTest, LeaderCancelledTest) {
+    boost::asio::io_context io_context;
+    RequestCoalescer coalescer;
+    boost::asio::cancellation_signal cancel;
+    bool leader_aborted = false;
+    RequestCoalescer::Response response;
+
+    auto fetch = [&]() -> boost::asio::awaitable<RequestCoalescer::Response> {
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(20));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        co_return std::make_shared<const std::string>("snapshot");
+    };
+    auto leader = [&]() -> boost::asio::awaitable<void> {
+        try {
+            co_await coalescer.run("GET http://example.com/depth", fetch);
+        } catch (const boost::system::system_error &e) {
+            leader_aborted = e.code() == boost::asio::error::operation_aborted;
+        }
+    };
+    auto waiter = [&]() -> boost::asio::awaitable<void> {
+        response = co_await coalescer.run("GET http://example.com/depth", fetch);
+    };
+    auto canceller = [&]() -> boost::asio::awaitable<void> {
+        boost::asio::steady_timer timer(co_await boost::asio::this_coro::executor, std::chrono::milliseconds(5));
+        co_await timer.async_wait(boost::asio::use_awaitable);
+        cancel.emit(boost::asio::cancellation_type::terminal);
+    };
+
+    boost::asio::co_spawn(io_context, leader(), boost::asio::bind_cancellation_slot(cancel.slot(), boost::asio::detached));
+    boost::asio::co_spawn(io_context, waiter(), boost::asio::detached);
+    boost::asio::co_spawn(io_context, canceller(), boost::asio::detached);
+    io_context.run();
+
+    EXPECT_TRUE(leader_aborted);
+    ASSERT_TRUE(response);
+    EXPECT_EQ("snapshot", *response);
+    EXPECT_EQ(0u, coalescer.in_flight());
+}
+
+// 测试共享内存环：读写、回绕和覆盖检测
+TEST(ShmRingTest, PublishAndReadTest) {
+    ShmRingWriter writer("/cpphttp_test_ring", 8192);
+    ShmRingReader reader("/cpphttp_test_ring");
+    ShmMessage msg;
+    EXPECT_EQ(ShmReadResult::empty, reader.read(msg));
+
+    // 写入总量远超容量，覆盖回绕路径
+    for (int i = 0; i < 200; i++) {
+        std::string payload(i % 100, static_cast<char>('a' + i % 26));
+        ASSERT_EQ(0, writer.publish(payload, i));
+        ASSERT_EQ(ShmReadResult::ok, reader.read(msg));
+        EXPECT_EQ(payload, msg.payload);
+        EXPECT_EQ(i, msg.timestamp_ns);
+        EXPECT_EQ(static_cast<uint64_t>(i + 1), msg.seq);
+        EXPECT_TRUE(reader.valid(msg));
+    }
+
+    // 写者超过读者一整圈
+    for (int i = 0; i < 100; i++) {
+        writer.publish(std::string(100, 'x'), i);
+    }
+    EXPECT_EQ(ShmReadResult::overrun, reader.read(msg));
+    EXPECT_EQ(1u, reader.overruns());
+    EXPECT_EQ(ShmReadResult::empty, reader.read(msg));
+
+    // 超过容量一半的消息拒绝写入，但占用一个 seq，读者可以发现丢失
+    EXPECT_EQ(-1, writer.publish(std::string(4096, 'x'), 0));
+    EXPECT_EQ(1u, writer.dropped());
+    EXPECT_EQ(300u, writer.published());
+    ASSERT_EQ(0, writer.publish("after", 0));
+    ASSERT_EQ(ShmReadResult::ok, reader.read(msg));
+    EXPECT_EQ(302u, msg.seq);
+    // overrun 跳过的 100 条加上被丢弃的 1 条
+    EXPECT_EQ(101u, reader.lost());
+
+    // 写者以更小的容量重启：旧读者仍然映射着原来的段，不会因为文件被截短而崩溃
+    ShmRingWriter restarted("/cpphttp_test_ring", 4096);
+    EXPECT_EQ(ShmReadResult::empty, reader.read(msg));
+    ShmRingReader fresh("/cpphttp_test_ring");
+    ASSERT_EQ(0, restarted.publish("fresh", 0));
+    ASSERT_EQ(ShmReadResult::ok, fresh.read(msg));
+    EXPECT_EQ("fresh", msg.payload);
+    restarted.unlink();
+}
+
+// 测试抓包文件写入和按类型、连接读取，超过初始大小时自动扩容
+TEST(CaptureTest, WriteAndReadTest) {
+    std::string path = "/tmp/cpphttp_capture_test.bin";
+    {
+        CaptureWriter writer(path, 4096);
+        auto ws_id = writer.next_connection_id();
+        auto http_id = writer.next_connection_id();
+        for (int i = 0; i < 100; i++) {
+            EXPECT_EQ(0, writer.append(CaptureKind::websocket, ws_id, i, std::string(100, 'w')));
+        }
+        EXPECT_EQ(0, writer.append(CaptureKind::http, http_id, 1000, "http body"));
+        EXPECT_EQ(101u, writer.records());
+    }
+
+    CaptureReader reader(path);
+    CaptureRecord record;
+    int count = 0;
+    while (reader.next(record, CaptureKind::websocket)) {
+        EXPECT_EQ(count, record.timestamp_ns);
+        EXPECT_EQ(100u, record.payload.size());
+        count++;
+    }
+    EXPECT_EQ(100, count);
+
+    reader.rewind();
+    ASSERT_TRUE(reader.next(record, CaptureKind::http, 2));
+    EXPECT_EQ("http body", record.payload);
+    EXPECT_FALSE(reader.next(record, CaptureKind::http));
+}
+
+// 测试 WebSocket 回放：不建立网络连接，按顺序读出录制的消息
+TEST(CaptureTest, WebSocketReplayTest) {
+    std::string path = "/tmp/cpphttp_replay_test.bin";
+    {
+        CaptureWriter writer(path);
+        writer.append(CaptureKind::websocket, 1, 0, "first");
+        writer.append(CaptureKind::websocket, 1, 1000, "second");
+    }
+
+    boost::asio::io_context io_context;
+    std::vector<std::string> messages;
+    bool closed = false;
+
+    auto test = [&]() -> boost::asio::awaitable<void> {
+        WebSocket ws;
+        ws.set_replay(std::make_shared<CaptureReader>(path));
+        co_await ws.connect();
+        co_await ws.write("subscribe");
+        try {
+            while (true) {
+                messages.push_back(co_await ws.read());
+            }
+        } catch (const boost::system::system_error &e) {
+            closed = true;
+        }
+    };
+
+    boost::asio::co_spawn(io_context, test(), boost::asio::detached);
+    io_context.run();
+    EXPECT_EQ((std::vector<std::string>{"first", "second"}), messages);
+    EXPECT_TRUE(closed);
+}
+
+// 测试一个 WebSocket 和一个 HttpRequest 共享同一个抓包文件回放，各自的读位置互不影响
+TEST(CaptureTest, SharedReplayTest) {
+    std::string path = "/tmp/cpphttp_shared_replay_test.bin";
+    uint32_t ws_id = 0;
+    uint32_t http_id = 0;
+    {
+        CaptureWriter writer(path);
+        ws_id = writer.next_connection_id();
+        http_id = writer.next_connection_id();
+        writer.append(CaptureKind::websocket, ws_id, 0, "trade 1");
+        writer.append(CaptureKind::http, http_id, 1, "snapshot 1");
+        writer.append(CaptureKind::websocket, ws_id, 2, "trade 2");
+        writer.append(CaptureKind::http, http_id, 3, "snapshot 2");
+    }
+
+    boost::asio::io_context io_context;
+    auto reader = std::make_shared<CaptureReader>(path);
+    std::vector<std::string> messages;
+    std::vector<std::string> bodies;
+
+    auto test = [&]() -> boost::asio::awaitable<void> {
+        WebSocket ws;
+        ws.set_replay(reader, ws_id);
+        HttpRequest request("http://example.com/depth", "GET");
+        request.set_replay(reader, http_id);
+        co_await ws.connect();
+        try {
+            while (true) {
+                messages.push_back(co_await ws.read());
+            }
+        } catch (const boost::system::system_error &e) {
+        }
+        bodies.push_back(co_await request.request());
+        bodies.push_back(co_await request.request());
+    };
+
+    boost::asio::co_spawn(io_context, test(), boost::asio::detached);
+    io_context.run();
+    EXPECT_EQ((std::vector<std::string>{"trade 1", "trade 2"}), messages);
+    EXPECT_EQ((std::vector<std::string>{"snapshot 1", "snapshot 2"}), bodies);
+
+    // reader 自带的读位置不受回放影响
+    CaptureRecord record;
+    ASSERT_TRUE(reader->next(record, CaptureKind::http));
+    EXPECT_EQ("snapshot 1", record.payload);
+}
+
+// 测试内核接收时间戳：本地回环连接上读取，时间戳应早于读取完成时间
+TEST(TimestampSocketTest, LoopbackTest) {
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    boost::asio::ip::tcp::socket client(io_context);
+    client.connect(acceptor.local_endpoint());
+    auto server = acceptor.accept();
+
+    TimestampSocket socket(std::move(client));
+    socket.mark();
+    boost::asio::write(server, boost::asio::buffer("hello", 5));
+
+    char buffer[16];
+    size_t received = 0;
+    auto on_read = [&](boost::system::error_code ec, size_t n) {
+        EXPECT_FALSE(ec);
+        received = n;
+    };
+    // 数据已经在队列中时直接读取，但 handler 不在发起调用中执行
+    socket.async_read_some(boost::asio::buffer(buffer), on_read);
+    EXPECT_EQ(0u, received);
+    io_context.run();
+    auto dequeue = std::chrono::system_clock::now();
+
+    EXPECT_EQ(5u, received);
+    if (socket.timestamping()) {
+        EXPECT_GT(socket.first_rx().time_since_epoch().count(), 0);
+        EXPECT_LE(socket.first_rx(), dequeue);
+    }
+
+    // 队列为空时等待可读后再读取；mark_rx() 是标记前最后一次读取的时间
+    auto previous = socket.last_rx();
+    socket.mark();
+    received = 0;
+    io_context.restart();
+    socket.async_read_some(boost::asio::buffer(buffer), on_read);
+    io_context.poll();
+    EXPECT_EQ(0u, received);
+    boost::asio::write(server, boost::asio::buffer("world!", 6));
+    io_context.run();
+
+    EXPECT_EQ(6u, received);
+    EXPECT_EQ(previous, socket.mark_rx());
+    if (socket.timestamping()) {
+        EXPECT_GE(socket.first_rx(), socket.mark_rx());
+    }
+}
+
+// 测试低延迟配置和选项设置接口
+TEST(LowLatencyTest, SocketOptionsTest) {
+    auto options = SocketOptions::low_latency();
+    EXPECT_TRUE(options.no_delay.value_or(false));
+    EXPECT_TRUE(options.quick_ack);
+    EXPECT_FALSE(options.recv_buffer.has_value());
+
+    Connect conn("example.com", 80);
+    EXPECT_EQ(0, conn.set_socket_options(options));
+    HttpRequest request("http://example.com/api", "GET");
+    EXPECT_EQ(0, request.set_socket_options(options));
+    WebSocket ws("ws://example.com/ws");
+    EXPECT_EQ(0, ws.set_socket_options(options));
+}
+
+// 测试 socket 选项设置失败时连接抛出异常，而不是静默忽略
+TEST(LowLatencyTest, OptionFailureTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    boost::system::error_code error;
+
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        SocketOptions options;
+        options.busy_poll_us = -1;
+        Connect conn("127.0.0.1", acceptor.local_endpoint().port());
+        conn.set_socket_options(options);
+        try {
+            co_await conn.connect();
+        } catch (const boost::system::system_error &e) {
+            error = e.code();
+        }
+    };
+
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+    EXPECT_EQ(boost::system::errc::invalid_argument, error);
+}
+
+// 测试忙轮询执行完所有 handler 后在没有剩余工作时返回
+TEST(LowLatencyTest, BusyPollTest) {
+    boost::asio::io_context io_context;
+    int count = 0;
+    for (int i = 0; i < 10; i++) {
+        boost::asio::post(io_context, [&count]() { count++; });
+    }
+    EXPECT_EQ(10u, run_busy_poll(io_context));
+    EXPECT_EQ(10, count);
+
+    // 绑定到不存在的 CPU 时报告错误
+    EXPECT_EQ(EINVAL, pin_thread(-1));
+    EXPECT_EQ(EINVAL, pin_thread(CPU_SETSIZE));
+    io_context.restart();
+    EXPECT_THROW(run_busy_poll(io_context, CPU_SETSIZE), std::system_error);
+}
+
+// 测试 UTF-8 校验，包括跨越 SIMD 块边界的多字节字符
+TEST(SimdTest, Utf8ValidationTest) {
+    EXPECT_TRUE(validate_utf8("", 0));
+    std::string ascii(100, 'a');
+    EXPECT_TRUE(validate_utf8(ascii.data(), ascii.size()));
+
+    std::string mixed = std::string(30, 'a') + "比特币" + std::string(40, 'b') + "\xf0\x9f\x9a\x80";
+    EXPECT_TRUE(validate_utf8(mixed.data(), mixed.size()));
+
+    const std::vector<std::string> invalid = {
+        "\xc0\x80",              // 过长编码
+        "\xed\xa0\x80",          // 代理区
+        "\xf4\x90\x80\x80",      // 超过 U+10FFFF
+        "\x80",                  // 孤立的后续字节
+        std::string(31, 'a') + "\xe6\xaf",  // 截断在块边界
+    };
+    for (const auto &text : invalid) {
+        EXPECT_FALSE(validate_utf8(text.data(), text.size()));
+        EXPECT_FALSE(scalar::validate_utf8(text.data(), text.size()));
+    }
+}
+
+// 测试 WebSocket 的 UTF-8 校验模式：all 模式下二进制帧也会校验，失败后连接仍可继续读取
+TEST(SimdTest, WebSocketUtf8ValidationTest) {
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    const std::string valid = R"({"price": "比特币"})";
+    const std::string invalid = "{\"price\": \"\xc0\x80\"}";
+
+    auto server = [&]() -> boost::asio::awaitable<void> {
+        boost::beast::websocket::stream<boost::asio::ip::tcp::socket> ws(
+            co_await acceptor.async_accept(boost::asio::use_awaitable));
+        co_await ws.async_accept(boost::asio::use_awaitable);
+        ws.binary(true);
+        for (const auto &frame : {valid, invalid, invalid}) {
+            co_await ws.async_write(boost::asio::buffer(frame), boost::asio::use_awaitable);
+        }
+        boost::beast::flat_buffer buffer;
+        co_await ws.async_read(buffer, boost::asio::as_tuple(boost::asio::use_awaitable));
+    };
+
+    std::vector<std::string> messages;
+    bool rejected = false;
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        WebSocket ws("ws://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()) + "/feed");
+        ws.set_utf8_validation(Utf8Validation::all);
+        co_await ws.connect();
+        messages.push_back(co_await ws.read());
+        try {
+            co_await ws.read();
+        } catch (const boost::system::system_error &e) {
+            rejected = e.code() == boost::beast::websocket::error::bad_frame_payload;
+        }
+        // 默认只校验文本帧，二进制帧原样返回
+        ws.set_utf8_validation(Utf8Validation::text);
+        messages.push_back(co_await ws.read());
+        co_await ws.close();
+    };
+
+    boost::asio::co_spawn(io_context, server(), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    EXPECT_TRUE(rejected);
+    EXPECT_EQ((std::vector<std::string>{valid, invalid}), messages);
+}
+
+// 测试 TLS 会话缓存：没有可恢复会话时不设置会话，握手失败时丢弃缓存，TLS 1.3 票据只使用一次
+TEST(TlsSessionTest, CacheTest) {
+    auto cache = std::make_shared<TlsSessionCache>();
+    SSL_CTX *ctx = SSL_CTX_new(TLS_client_method());
+    TlsSessionCache::enable(ctx);
+    SSL *ssl = SSL_new(ctx);
+
+    EXPECT_FALSE(cache->attach(ssl, "example.com:443"));
+
+    // 新建的空会话没有票据，不能用于恢复
+    cache->store("example.com:443", SSL_SESSION_new());
+    EXPECT_EQ(1u, cache->size());
+    EXPECT_FALSE(cache->attach(ssl, "example.com:443"));
+
+    cache->on_handshake(ssl, "example.com:443", false);
+    EXPECT_EQ(0u, cache->size());
+    EXPECT_EQ(0u, cache->resumed());
+    SSL_free(ssl);
+
+    auto make_session = [](int version, unsigned char id) {
+        SSL_SESSION *session = SSL_SESSION_new();
+        unsigned char session_id[32] = {id};
+        SSL_SESSION_set1_id(session, session_id, sizeof(session_id));
+        SSL_SESSION_set_protocol_version(session, version);
+        return session;
+    };
+    auto attached_id = [&](const std::string &key) {
+        SSL *ssl = SSL_new(ctx);
+        int id = -1;
+        if (cache->attach(ssl, key)) {
+            unsigned int length = 0;
+            id = SSL_SESSION_get_id(SSL_get_session(ssl), &length)[0];
+        }
+        SSL_free(ssl);
+        return id;
+    };
+
+    // TLS 1.3 票据只用一次，最新的先用，超出上限时丢弃最旧的
+    for (unsigned char id = 0; id < 6; id++) {
+        cache->store("example.com:443", make_session(TLS1_3_VERSION, id));
+    }
+    EXPECT_EQ(4u, cache->size());
+    EXPECT_EQ(5, attached_id("example.com:443"));
+    EXPECT_EQ(4, attached_id("example.com:443"));
+    EXPECT_EQ(2u, cache->size());
+
+    // TLS 1.2 会话替换旧票据，并且可以重复使用
+    cache->store("example.com:443", make_session(TLS1_2_VERSION, 9));
+    EXPECT_EQ(1u, cache->size());
+    EXPECT_EQ(9, attached_id("example.com:443"));
+    EXPECT_EQ(9, attached_id("example.com:443"));
+    EXPECT_EQ(1u, cache->size());
+
+    SSL_CTX_free(ctx);
+
+    auto options = SocketOptions::low_latency();
+    EXPECT_FALSE(options.fast_open);
+    EXPECT_FALSE(options.early_data);
+    options.fast_open = true;
+    options.early_data = true;
+    options.session_cache = cache;
+    Connect conn("example.com", 443);
+    EXPECT_EQ(0, conn.set_socket_options(options));
+    EXPECT_EQ(0, conn.set_early_data("GET / HTTP/1.1\r\nHost: example.com\r\n\r\n"));
+    // 握手之前没有早期数据被接受，调用者需要自己发送请求
+    EXPECT_FALSE(conn.early_data_accepted());
+}
+
+namespace {
+
+// 自签名的 Ed25519 证书，客户端不校验证书
+SSL_CTX *make_tls_server_context() {
+    SSL_CTX *ctx = SSL_CTX_new(TLS_server_method());
+    EVP_PKEY *key = nullptr;
+    EVP_PKEY_CTX *key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_ED25519, nullptr);
+    EVP_PKEY_keygen_init(key_ctx);
+    EVP_PKEY_keygen(key_ctx, &key);
+    EVP_PKEY_CTX_free(key_ctx);
+
+    X509 *cert = X509_new();
+    ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+    X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+    X509_gmtime_adj(X509_getm_notAfter(cert), 3600);
+    X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+                               reinterpret_cast<const unsigned char *>("127.0.0.1"), -1, -1, 0);
+    X509_set_issuer_name(cert, X509_get_subject_name(cert));
+    X509_set_pubkey(cert, key);
+    X509_sign(cert, key, nullptr);
+
+    SSL_CTX_use_certificate(ctx, cert);
+    SSL_CTX_use_PrivateKey(ctx, key);
+    SSL_CTX_set_min_proto_version(ctx, TLS1_3_VERSION);
+    SSL_CTX_set_max_early_data(ctx, 16384);
+    // 测试里同一张票据不会出现两次，关闭服务器的防重放缓存，接受与否只由 read_early_data 决定
+    SSL_CTX_set_options(ctx, SSL_OP_NO_ANTI_REPLAY);
+    X509_free(cert);
+    EVP_PKEY_free(key);
+    return ctx;
+}
+
+struct TlsExchange {
+    std::string early_data;
+    std::string request;
+    bool resumed = false;
+};
+
+// 本地回环 TLS 服务器的一个连接，阻塞读写；read_early_data 为 false 时不读取早期数据，OpenSSL 会拒绝并丢弃它
+TlsExchange serve_tls(SSL_CTX *ctx, int fd, bool read_early_data) {
+    TlsExchange exchange;
+    timeval timeout{5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    SSL *ssl = SSL_new(ctx);
+    SSL_set_fd(ssl, fd);
+
+    char buffer[4096];
+    size_t size = 0;
+    while (read_early_data) {
+        int result = SSL_read_early_data(ssl, buffer, sizeof(buffer), &size);
+        if (result == SSL_READ_EARLY_DATA_ERROR) {
+            break;
+        }
+        exchange.early_data.append(buffer, size);
+        if (result == SSL_READ_EARLY_DATA_FINISH) {
+            break;
+        }
+    }
+    if (SSL_accept(ssl) == 1) {
+        exchange.resumed = SSL_session_reused(ssl);
+        // 早期数据里已经有完整请求时不再读取
+        while (exchange.early_data.find("\r\n\r\n") == std::string::npos &&
+               exchange.request.find("\r\n\r\n") == std::string::npos) {
+            int n = SSL_read(ssl, buffer, sizeof(buffer));
+            if (n <= 0) {
+                break;
+            }
+            exchange.request.append(buffer, n);
+        }
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok";
+        SSL_write(ssl, response.data(), static_cast<int>(response.size()));
+        SSL_shutdown(ssl);
+    }
+    SSL_free(ssl);
+    close(fd);
+    return exchange;
+}
+
+}  // namespace
+
+// 测试 TLS 1.3 早期数据：恢复会话的 GET 随 ClientHello 发出；服务器拒绝时握手后重发；PUT 不使用早期数据
+TEST(TlsSessionTest, EarlyDataTest) {
+    SSL_CTX *server_ctx = make_tls_server_context();
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    std::vector<TlsExchange> exchanges;
+
+    // 第 2 个连接不读取早期数据，其余连接都读取
+    std::thread server([&]() {
+        for (int i = 0; i < 4; i++) {
+            pollfd listener{acceptor.native_handle(), POLLIN, 0};
+            if (poll(&listener, 1, 5000) != 1) {
+                break;
+            }
+            exchanges.push_back(serve_tls(server_ctx, accept(acceptor.native_handle(), nullptr, nullptr), i != 2));
+        }
+    });
+
+    auto cache = std::make_shared<TlsSessionCache>();
+    SocketOptions options;
+    options.session_cache = cache;
+    options.early_data = true;
+    std::vector<std::string> bodies;
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        auto url = "https://127.0.0.1:" + std::to_string(acceptor.local_endpoint().port());
+        for (auto [path, method] : std::vector<std::pair<std::string, std::string>>{
+                 {"/ticket", "GET"}, {"/early", "GET"}, {"/rejected", "GET"}, {"/put", "PUT"}}) {
+            HttpRequest request(url + path, method);
+            request.set_socket_options(options);
+            bodies.push_back(co_await request.request());
+        }
+    };
+
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(10));
+    server.join();
+    SSL_CTX_free(server_ctx);
+
+    EXPECT_EQ((std::vector<std::string>{"ok", "ok", "ok", "ok"}), bodies);
+    ASSERT_EQ(4u, exchanges.size());
+    // 第一次完整握手，拿到票据
+    EXPECT_FALSE(exchanges[0].resumed);
+    EXPECT_TRUE(exchanges[0].early_data.empty());
+    EXPECT_TRUE(exchanges[0].request.starts_with("GET /ticket "));
+    // 早期数据被接受，握手后不再发送请求
+    EXPECT_TRUE(exchanges[1].resumed);
+    EXPECT_TRUE(exchanges[1].early_data.starts_with("GET /early "));
+    EXPECT_TRUE(exchanges[1].request.empty());
+    // 早期数据被拒绝并丢弃，握手后重发
+    EXPECT_TRUE(exchanges[2].resumed);
+    EXPECT_TRUE(exchanges[2].early_data.empty());
+    EXPECT_TRUE(exchanges[2].request.starts_with("GET /rejected "));
+    // PUT 可以恢复会话，但不放进早期数据
+    EXPECT_TRUE(exchanges[3].resumed);
+    EXPECT_TRUE(exchanges[3].early_data.empty());
+    EXPECT_TRUE(exchanges[3].request.starts_with("PUT /put "));
+    EXPECT_EQ(3u, cache->resumed());
+    EXPECT_EQ(1u, cache->full_handshakes());
+}
+
+// 测试端点组优先选择未测量和延迟最低的端点，连续失败后剔除
+TEST(EndpointGroupTest, SelectTest) {
+    EndpointGroup group({"https://a.example.com", "https://b.example.com", "https://c.example.com"}, 0.0,
+                        std::chrono::milliseconds(50));
+    EXPECT_EQ(3u, group.size());
+    EXPECT_EQ(0u, group.select());
+
+    group.record(0, std::chrono::microseconds(5000), true);
+    group.record(1, std::chrono::microseconds(1000), true);
+    group.record(2, std::chrono::microseconds(3000), true);
+    EXPECT_EQ(1u, group.select());
+    EXPECT_EQ(2u, group.select(1));
+    EXPECT_EQ(0u, group.select(5));
+
+    for (int i = 0; i < 3; i++) {
+        group.record(1, std::chrono::microseconds(10), false);
+    }
+    EXPECT_TRUE(group.score(1).ejected);
+    EXPECT_EQ(2u, group.select());
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    EXPECT_FALSE(group.score(1).ejected);
+    EXPECT_GT(group.score(1).error_rate, 0.0);
+
+    HttpRequest request("https://a.example.com/api", "GET");
+    EXPECT_EQ(0, request.set_endpoint_group(std::make_shared<EndpointGroup>(std::vector<std::string>{"https://a.example.com"})));
+    WebSocket ws("wss://a.example.com/ws");
+    EXPECT_EQ(0, ws.set_endpoint_group(std::make_shared<EndpointGroup>(std::vector<std::string>{"wss://a.example.com"})));
+}
+
+// 测试解析地址按连接延迟排序，剔除的地址排在最后
+TEST(EndpointGroupTest, OrderTest) {
+    EndpointGroup group({"https://a.example.com"});
+    std::vector<boost::asio::ip::tcp::endpoint> endpoints = {
+        {boost::asio::ip::make_address("10.0.0.1"), 443},
+        {boost::asio::ip::make_address("10.0.0.2"), 443},
+        {boost::asio::ip::make_address("10.0.0.3"), 443},
+    };
+    group.record_address(endpoints[0].address(), std::chrono::microseconds(900), true);
+    group.record_address(endpoints[1].address(), std::chrono::microseconds(100), true);
+    for (int i = 0; i < 3; i++) {
+        group.record_address(endpoints[2].address(), std::chrono::microseconds(1), false);
+    }
+
+    group.order(endpoints);
+    EXPECT_EQ("10.0.0.2", endpoints[0].address().to_string());
+    EXPECT_EQ("10.0.0.1", endpoints[1].address().to_string());
+    EXPECT_EQ("10.0.0.3", endpoints[2].address().to_string());
+    EXPECT_TRUE(group.address_score(endpoints[2].address()).ejected);
+}
+
+// 测试 HttpRequest 经端点组路由：改写 Host，路径来自 URL，对冲请求发往次优端点，5xx 记为失败
+TEST(EndpointGroupTest, HttpRequestTest) {
+    boost::asio::io_context io_context;
+    tcp::acceptor primary(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    tcp::acceptor secondary(io_context, {boost::asio::ip::make_address("127.0.0.1"), 0});
+    auto group = std::make_shared<EndpointGroup>(
+        std::vector<std::string>{loopback_url(primary, ""), loopback_url(secondary, "")}, 0.0);
+    group->record(0, std::chrono::microseconds(1000), true);
+    group->record(1, std::chrono::microseconds(5000), true);
+    auto policy = std::make_shared<HedgePolicy>(std::chrono::milliseconds(20), 0.0);
+    std::vector<std::string> hosts, targets;
+    std::string body, error;
+
+    auto primary_handler = [&](size_t index, const http::request<http::string_body> &req, tcp::socket &socket)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        hosts.push_back(std::string(req[http::field::host]));
+        targets.push_back(std::string(req.target()));
+        if (index == 0) {
+            // 第一个请求不响应，等待对冲胜出后客户端关闭连接
+            co_await socket.async_wait(tcp::socket::wait_read, boost::asio::use_awaitable);
+            co_return std::nullopt;
+        }
+        co_return make_response("unavailable", http::status::service_unavailable);
+    };
+    auto secondary_handler = [&](size_t, const http::request<http::string_body> &req, tcp::socket &)
+        -> boost::asio::awaitable<std::optional<http::response<http::string_body>>> {
+        hosts.push_back(std::string(req[http::field::host]));
+        targets.push_back(std::string(req.target()));
+        co_return make_response("secondary");
+    };
+    auto client = [&]() -> boost::asio::awaitable<void> {
+        HttpRequest hedged("http://api.example.invalid/depth", "GET");
+        hedged.set_endpoint_group(group);
+        hedged.set_hedge_policy(policy);
+        body = co_await hedged.request();
+
+        HttpRequest failing("http://api.example.invalid/ticker", "GET");
+        failing.set_endpoint_group(group);
+        try {
+            co_await failing.request();
+        } catch (const std::runtime_error &e) {
+            error = e.what();
+        }
+    };
+
+    boost::asio::co_spawn(io_context, serve_http(primary, 2, primary_handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, serve_http(secondary, 1, secondary_handler), boost::asio::detached);
+    boost::asio::co_spawn(io_context, client(), boost::asio::detached);
+    io_context.run_for(std::chrono::seconds(5));
+
+    EXPECT_EQ("secondary", body);
+    EXPECT_EQ(1u, policy->hedges_won());
+    EXPECT_EQ((std::vector<std::string>{"127.0.0.1", "127.0.0.1", "127.0.0.1"}), hosts);
+    EXPECT_EQ((std::vector<std::string>{"/depth", "/depth", "/ticker"}), targets);
+    EXPECT_NE(std::string::npos, error.find("503"));
+
+    // 被取消的主请求不计入统计，对冲成功和 503 各记一次
+    EXPECT_EQ(2u, group->score(0).samples);
+    EXPECT_GT(group->score(0).error_rate, 0.0);
+    EXPECT_EQ(2u, group->score(1).samples);
+    EXPECT_EQ(0.0, group->score(1).error_rate);
+}
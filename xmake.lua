@@ -3,6 +3,17 @@ add_requires("boost[asio,beast,url,system,filesystem,thread]")
 add_rules("plugin.compile_commands.autoupdate", {outputdir = "build/"})
 set_languages("c++23")
 
+-- 可选：为 PaddedBuffer 提供 simdjson 按需解析接口
+option("simdjson")
+    set_default(false)
+    set_showmenu(true)
+    set_description("Enable simdjson helpers on PaddedBuffer")
+option_end()
+
+if has_config("simdjson") then
+    add_requires("simdjson")
+end
+
 -- 在debug模式下添加gtest依赖
 if is_mode("debug") then
     add_requires("gtest")
@@ -13,6 +24,23 @@ target("cpphttp")
     add_includedirs("include")
     add_files("src/*.cpp")
     add_packages("openssl", "cryptopp", "liburing", "boost", "fmt")
+    add_syslinks("rt")
+    add_defines("BOOST_ASIO_HAS_IO_URING", "BOOST_ASIO_HAS_FILE")
+    set_toolset("cxx", "clang")
+    set_toolset("ld", "clang++")
+    if has_config("simdjson") then
+        add_packages("simdjson", {public = true})
+        add_defines("CPPHTTP_WITH_SIMDJSON", {public = true})
+    end
+
+-- 性能测试，不默认构建：xmake build cpphttp_bench && xmake run cpphttp_bench
+target("cpphttp_bench")
+    set_kind("binary")
+    set_default(false)
+    add_includedirs("include")
+    add_files("bench/*.cpp")
+    add_deps("cpphttp")
+    add_packages("openssl", "cryptopp", "liburing", "boost", "fmt")
     add_defines("BOOST_ASIO_HAS_IO_URING", "BOOST_ASIO_HAS_FILE")
     set_toolset("cxx", "clang")
     set_toolset("ld", "clang++")